@@ -0,0 +1,414 @@
+// Measures HPACK encoding, decoding and its primitives on several header corpora.
+// Results are printed to stdout as JSON, so runs of different library revisions can be compared by a script.
+// Usage: h2pp_bench_hpack [rounds]
+//
+// Every corpus is a sequence of header blocks of one connection. The dynamic table is shared by blocks
+// of a sequence, so a decoder gets blocks that are encoded by one encoder in the same order.
+// Allocations are counted by replaced global 'operator new'. Buffers are allocated from the default pooled resource,
+// so its allocations are reported separately: pool hits never reach 'operator new', pool misses reach it.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <hpack/decoder.h>
+#include <hpack/encoder.h>
+#include <hpack/huffman.h>
+#include <hpack/integer.h>
+#include <hpack/string.h>
+#include <utils/memory_resource.h>
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+// Keeps results alive for the optimizer
+volatile std::size_t checksum = 0;
+
+using block = std::deque<rfc7541::header_field>;
+
+struct corpus {
+  std::string name;
+  std::vector<block> blocks;
+};
+
+// RFC 7541 C.3. Requests
+corpus rfc7541_requests() {
+  return {"rfc7541_c3_requests",
+          {{{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}},
+           {{":method", "GET"},
+            {":scheme", "http"},
+            {":path", "/"},
+            {":authority", "www.example.com"},
+            {"cache-control", "no-cache"}},
+           {{":method", "GET"},
+            {":scheme", "https"},
+            {":path", "/index.html"},
+            {":authority", "www.example.com"},
+            {"custom-key", "custom-value"}}}};
+}
+
+// RFC 7541 C.5. Responses
+corpus rfc7541_responses() {
+  return {"rfc7541_c5_responses",
+          {{{":status", "302"},
+            {"cache-control", "private"},
+            {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+            {"location", "https://www.example.com"}},
+           {{":status", "307"},
+            {"cache-control", "private"},
+            {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+            {"location", "https://www.example.com"}},
+           {{":status", "200"},
+            {"cache-control", "private"},
+            {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+            {"location", "https://www.example.com"},
+            {"content-encoding", "gzip"},
+            {"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}}}};
+}
+
+std::string random_token(std::mt19937 &gen, std::size_t size) {
+  static constexpr char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  std::uniform_int_distribution<std::size_t> dist(0, sizeof(Alphabet) - 2);
+  std::string result(size, ' ');
+  for (auto &c : result) {
+    c = Alphabet[dist(gen)];
+  }
+  return result;
+}
+
+// Page and subresource loads of a browser. Paths and a few cookies change
+corpus browser(std::mt19937 &gen) {
+  static constexpr const char *Accepts[] = {
+      "text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8",
+      "text/css,*/*;q=0.1",
+      "image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8",
+      "*/*",
+  };
+  const auto session = random_token(gen, 32);
+
+  corpus result{"browser", {}};
+  for (int i = 0; i < 64; ++i) {
+    result.blocks.push_back({
+        {":method", "GET"},
+        {":authority", "www.example.com"},
+        {":scheme", "https"},
+        {":path", "/static/" + random_token(gen, 12) + (i % 4 == 1 ? ".css" : ".js")},
+        {"user-agent", "Mozilla/5.0 (X11; Linux x86_64; rv:121.0) Gecko/20100101 Firefox/121.0"},
+        {"accept", Accepts[i % std::size(Accepts)]},
+        {"accept-language", "en-US,en;q=0.5"},
+        {"accept-encoding", "gzip, deflate, br"},
+        {"referer", "https://www.example.com/"},
+        {"cookie", "session=" + session + "; _ga=GA1.2." + random_token(gen, 10)},
+        {"sec-fetch-dest", i == 0 ? "document" : "script"},
+        {"sec-fetch-mode", i == 0 ? "navigate" : "no-cors"},
+        {"sec-fetch-site", "same-origin"},
+    });
+  }
+  return result;
+}
+
+// Unary gRPC calls with per call tracing metadata
+corpus grpc(std::mt19937 &gen) {
+  static constexpr const char *Methods[] = {"/inventory.v1.Inventory/GetItem", "/inventory.v1.Inventory/ListItems",
+                                            "/orders.v2.Orders/Create", "/health.v1.Health/Check"};
+  corpus result{"grpc", {}};
+  for (int i = 0; i < 64; ++i) {
+    result.blocks.push_back({
+        {":method", "POST"},
+        {":scheme", "https"},
+        {":path", Methods[i % std::size(Methods)]},
+        {":authority", "inventory.internal:443"},
+        {"content-type", "application/grpc"},
+        {"te", "trailers"},
+        {"grpc-timeout", std::to_string(100 + i % 7) + "m"},
+        {"grpc-accept-encoding", "identity,deflate,gzip"},
+        {"user-agent", "grpc-c++/1.60.0 grpc-c/36.0.0 (linux; chttp2)"},
+        {"traceparent", "00-" + random_token(gen, 32) + "-" + random_token(gen, 16) + "-01"},
+        {"x-request-id", random_token(gen, 24)},
+    });
+  }
+  return result;
+}
+
+// A cookie that is larger than the default dynamic table. It can't be indexed
+corpus large_cookie(std::mt19937 &gen) {
+  std::string cookie;
+  for (int i = 0; i < 64; ++i) {
+    cookie += "c" + std::to_string(i) + "=" + random_token(gen, 80) + "; ";
+  }
+
+  corpus result{"large_cookie", {}};
+  for (int i = 0; i < 16; ++i) {
+    result.blocks.push_back({
+        {":method", "GET"},
+        {":authority", "www.example.com"},
+        {":scheme", "https"},
+        {":path", "/api/v1/profile?page=" + std::to_string(i)},
+        {"cookie", cookie + "tick=" + std::to_string(i)},
+    });
+  }
+  return result;
+}
+
+struct counters {
+  double ns = 0;
+  std::size_t items = 0;
+  std::size_t bytes = 0;
+  std::size_t blocks = 0;
+  uint64_t allocs = 0;
+  // Allocations from the default pooled resource and the part of them that is served by free lists
+  uint64_t pool_allocs = 0;
+  uint64_t pool_hits = 0;
+};
+
+uint64_t pool_allocations(const utils::pooled_resource::statistics &s) { return s.hits + s.misses + s.unpooled; }
+
+template <typename F> counters measure(F &&f) {
+  counters result;
+  auto allocs = allocations.load(std::memory_order_relaxed);
+  auto pool_stats = utils::default_pooled_resource().get_statistics();
+  auto start = std::chrono::steady_clock::now();
+  f(result);
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  result.ns = elapsed.count();
+  result.allocs = allocations.load(std::memory_order_relaxed) - allocs;
+  auto pool_stats_after = utils::default_pooled_resource().get_statistics();
+  result.pool_allocs = pool_allocations(pool_stats_after) - pool_allocations(pool_stats);
+  result.pool_hits = pool_stats_after.hits - pool_stats.hits;
+  return result;
+}
+
+struct json_writer {
+  bool first = true;
+
+  void add(const char *benchmark, const std::string &corpus, const char *item, const counters &c) {
+    std::printf("%s\n    {\"benchmark\": \"%s\", \"corpus\": \"%s\", \"item\": \"%s\", \"items\": %zu, "
+                "\"ns_per_item\": %.2f, \"bytes_per_second\": %.0f",
+                first ? "" : ",", benchmark, corpus.c_str(), item, c.items, c.ns / c.items, c.bytes * 1e9 / c.ns);
+    if (c.blocks != 0) {
+      std::printf(", \"blocks\": %zu, \"allocations_per_block\": %.2f, \"pool_allocations_per_block\": %.2f, "
+                  "\"pool_hits_per_block\": %.2f",
+                  c.blocks, double(c.allocs) / c.blocks, double(c.pool_allocs) / c.blocks,
+                  double(c.pool_hits) / c.blocks);
+    } else {
+      std::printf(", \"allocations_per_item\": %.2f, \"pool_allocations_per_item\": %.2f",
+                  double(c.allocs) / c.items, double(c.pool_allocs) / c.items);
+    }
+    std::printf("}");
+    first = false;
+  }
+};
+
+std::vector<std::vector<uint8_t>> encode_blocks(const corpus &c, std::size_t rounds) {
+  rfc7541::encoder encoder;
+  std::vector<std::vector<uint8_t>> result;
+  for (std::size_t r = 0; r < rounds; ++r) {
+    for (const auto &b : c.blocks) {
+      auto [buffers, count] = encoder.encode(b, 1 << 24);
+      auto &encoded = result.emplace_back();
+      for (const auto &buffer : buffers) {
+        encoded.insert(encoded.end(), buffer.data_view().begin(), buffer.data_view().end());
+      }
+    }
+  }
+  return result;
+}
+
+void bench_blocks(json_writer &out, const corpus &c, std::size_t rounds) {
+  // Encoded blocks are the same for all decoders since encoding is deterministic
+  const auto encoded = encode_blocks(c, rounds);
+
+  out.add("encoder_encode", c.name, "field", measure([&](counters &r) {
+            rfc7541::encoder encoder;
+            for (std::size_t i = 0; i < rounds; ++i) {
+              for (const auto &b : c.blocks) {
+                auto [buffers, count] = encoder.encode(b, 1 << 24);
+                for (const auto &buffer : buffers) {
+                  r.bytes += buffer.data_view().size();
+                }
+                r.items += count;
+                ++r.blocks;
+              }
+            }
+          }));
+
+  out.add("decoder_decode_views", c.name, "field", measure([&](counters &r) {
+            rfc7541::decoder decoder;
+            rfc7541::header_view views;
+            for (const auto &e : encoded) {
+              views.clear();
+              decoder.decode(e, views);
+              checksum = checksum + views.back().value().size();
+              r.items += views.size();
+              r.bytes += e.size();
+              ++r.blocks;
+            }
+          }));
+
+  out.add("decoder_decode_fields", c.name, "field", measure([&](counters &r) {
+            rfc7541::decoder decoder;
+            for (const auto &e : encoded) {
+              auto fields = decoder.decode(e);
+              checksum = checksum + fields.back().value().size();
+              r.items += fields.size();
+              r.bytes += e.size();
+              ++r.blocks;
+            }
+          }));
+}
+
+void bench_strings(json_writer &out, const corpus &c, std::size_t rounds) {
+  std::vector<std::span<const uint8_t>> values;
+  std::size_t total_size = 0;
+  for (const auto &b : c.blocks) {
+    for (const auto &f : b) {
+      values.push_back(f.value());
+      total_size += f.value().size();
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> huffman_encoded;
+  std::vector<std::vector<uint8_t>> hpack_strings;
+  for (auto v : values) {
+    auto &encoded = huffman_encoded.emplace_back(rfc7541::huffman::encoded_size(v));
+    rfc7541::huffman::encode(v, encoded);
+
+    auto prefix = rfc7541::integer::encode(rfc7541::constants::string_flag::ENCODED, uint32_t(encoded.size()));
+    auto &str = hpack_strings.emplace_back(prefix.as_span().begin(), prefix.as_span().end());
+    str.insert(str.end(), encoded.begin(), encoded.end());
+  }
+
+  out.add("huffman_encoded_size", c.name, "string", measure([&](counters &r) {
+            for (std::size_t i = 0; i < rounds; ++i) {
+              for (auto v : values) {
+                checksum = checksum + rfc7541::huffman::encoded_size(v);
+              }
+              r.items += values.size();
+              r.bytes += total_size;
+            }
+          }));
+
+  std::vector<uint8_t> buffer(rfc7541::huffman::max_decoded_size(total_size));
+  out.add("huffman_encode", c.name, "string", measure([&](counters &r) {
+            for (std::size_t i = 0; i < rounds; ++i) {
+              for (std::size_t v = 0; v < values.size(); ++v) {
+                auto *end = rfc7541::huffman::encode(values[v], {buffer.data(), huffman_encoded[v].size()});
+                checksum = checksum + (end - buffer.data());
+              }
+              r.items += values.size();
+              r.bytes += total_size;
+            }
+          }));
+
+  out.add("huffman_decode", c.name, "string", measure([&](counters &r) {
+            for (std::size_t i = 0; i < rounds; ++i) {
+              for (const auto &e : huffman_encoded) {
+                rfc7541::huffman::decode_state state;
+                auto *end = rfc7541::huffman::decode(e, buffer.data(), state);
+                checksum = checksum + (end - buffer.data());
+              }
+              r.items += values.size();
+              r.bytes += total_size;
+            }
+          }));
+
+  out.add("string_decode", c.name, "string", measure([&](counters &r) {
+            rfc7541::arena storage;
+            for (std::size_t i = 0; i < rounds; ++i) {
+              storage.reset();
+              for (const auto &s : hpack_strings) {
+                checksum = checksum + rfc7541::string::decode(s, storage).value.size();
+              }
+              r.items += values.size();
+              r.bytes += total_size;
+            }
+          }));
+}
+
+void bench_integers(json_writer &out, std::size_t rounds) {
+  // Lengths and indexes as they appear in header blocks. Most fit into a prefix or a single extra byte
+  std::vector<uint32_t> values;
+  std::mt19937 gen(7);
+  std::geometric_distribution<uint32_t> dist(0.02);
+  for (int i = 0; i < 1024; ++i) {
+    values.push_back(i % 64 == 0 ? 1 << 20 : dist(gen));
+  }
+
+  // 'bits' is a count of representation bits in front of a prefix. 1 for string lengths, 4 for literal name indexes
+  for (unsigned bits : {1u, 4u}) {
+    const auto corpus = "prefix_" + std::to_string(8 - bits);
+    std::vector<uint8_t> encoded;
+    for (auto v : values) {
+      auto e = rfc7541::integer::encode(0, bits, v);
+      encoded.insert(encoded.end(), e.as_span().begin(), e.as_span().end());
+    }
+
+    out.add("integer_encode", corpus, "integer", measure([&](counters &r) {
+              for (std::size_t i = 0; i < rounds; ++i) {
+                for (auto v : values) {
+                  checksum = checksum + rfc7541::integer::encode(0, bits, v).length;
+                }
+                r.items += values.size();
+                r.bytes += encoded.size();
+              }
+            }));
+
+    out.add("integer_decode", corpus, "integer", measure([&](counters &r) {
+              for (std::size_t i = 0; i < rounds; ++i) {
+                std::span<const uint8_t> src = encoded;
+                while (!src.empty()) {
+                  auto d = rfc7541::integer::decode(bits, src);
+                  checksum = checksum + d.value;
+                  src = src.subspan(d.used_bytes);
+                }
+                r.items += values.size();
+                r.bytes += encoded.size();
+              }
+            }));
+  }
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+int main(int argc, char *argv[]) {
+  std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+  if (rounds == 0) {
+    std::fprintf(stderr, "Usage: %s [rounds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::mt19937 gen(1);
+  const std::vector<corpus> corpora = {rfc7541_requests(), rfc7541_responses(), browser(gen), grpc(gen),
+                                       large_cookie(gen)};
+
+  json_writer out;
+  std::printf("{\n  \"library\": \"h2pp\",\n  \"rounds\": %zu,\n  \"results\": [", rounds);
+  for (const auto &c : corpora) {
+    // About 4 * rounds header blocks of every corpus are processed
+    auto corpus_rounds = std::max<std::size_t>(1, rounds * 4 / c.blocks.size());
+    bench_blocks(out, c, corpus_rounds);
+    bench_strings(out, c, corpus_rounds);
+  }
+  bench_integers(out, rounds);
+  std::printf("\n  ]\n}\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,71 @@
+// Measures HPACK encoder cost per header field for different dynamic table sizes.
+// Requests carry a few constant fields and a lot of fields with rotating values,
+// so the dynamic table is full and it is churned by every request.
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <string>
+
+#include <hpack/encoder.h>
+
+namespace {
+
+std::deque<rfc7541::header_field> make_request(std::mt19937 &gen) {
+  std::uniform_int_distribution<int> dist(0, 4095);
+
+  std::deque<rfc7541::header_field> fields = {
+      {":method", "GET"},
+      {":scheme", "https"},
+      {":authority", "api.example.com"},
+      {":path", "/v1/items/" + std::to_string(dist(gen))},
+      {"user-agent", "h2pp-bench/0.0.1"},
+      {"accept", "application/json"},
+  };
+  for (int i = 0; i < 24; ++i) {
+    fields.emplace_back("x-header-" + std::to_string(i), "value-" + std::to_string(dist(gen) % 64));
+  }
+  fields.emplace_back("x-request-id", std::to_string(dist(gen)) + "-" + std::to_string(dist(gen)));
+  return fields;
+}
+
+void run(std::size_t table_size) {
+  constexpr int Requests = 20000;
+
+  rfc7541::encoder::encoder_config config;
+  config.init_table_size = table_size;
+  config.max_table_size = table_size;
+  rfc7541::encoder encoder(config);
+
+  std::mt19937 gen(1);
+  std::vector<std::deque<rfc7541::header_field>> requests;
+  for (int i = 0; i < 256; ++i) {
+    requests.emplace_back(make_request(gen));
+  }
+
+  std::size_t fields = 0;
+  std::size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < Requests; ++i) {
+    const auto &rq = requests[i % requests.size()];
+    auto [buffers, count] = encoder.encode(rq, 1 << 20);
+    fields += count;
+    for (const auto &b : buffers) {
+      bytes += b.data_view().size();
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+  std::printf("table %6zu bytes: %8.1f ns/field, %6.2f bytes/field\n", table_size, elapsed.count() / fields,
+              double(bytes) / fields);
+}
+
+} // namespace
+
+int main() {
+  for (auto size : {4096, 16384, 65536}) {
+    run(size);
+  }
+  return 0;
+}
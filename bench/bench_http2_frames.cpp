@@ -0,0 +1,199 @@
+// Measures parsing, validation, connection window accounting and dispatch of received frames.
+// Frames are processed one by one and split into 'frame_batch' first.
+// A stream is a mix of small frames: PING, WINDOW_UPDATE, SETTINGS ACK, HEADERS, CONTINUATION, RST_STREAM and DATA.
+// The second stream has an invalid frame in every 16 frames. An error is returned as a value and parsing goes on,
+// so the error path cost is measured too.
+// Results are printed to stdout as JSON.
+// Usage: h2pp_bench_http2_frames [rounds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <dummy_window.h>
+#include <frame.h>
+
+namespace {
+
+void append_frame(std::vector<uint8_t> &out, http2::frame_type type, uint8_t flags, uint32_t stream_id,
+                  std::size_t payload_size) {
+  const uint8_t header[] = {uint8_t(payload_size >> 16), uint8_t(payload_size >> 8), uint8_t(payload_size),
+                            uint8_t(type),
+                            flags,
+                            uint8_t(stream_id >> 24),
+                            uint8_t(stream_id >> 16),
+                            uint8_t(stream_id >> 8),
+                            uint8_t(stream_id)};
+  out.insert(out.end(), std::begin(header), std::end(header));
+  out.insert(out.end(), payload_size, 0x82);
+}
+
+std::vector<uint8_t> make_stream(std::size_t frames, bool with_errors) {
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> kind(0, 6);
+  std::uniform_int_distribution<std::size_t> size(1, 64);
+
+  std::vector<uint8_t> out;
+  for (std::size_t i = 0; i < frames; ++i) {
+    uint32_t stream_id = 1 + 2 * (i % 50);
+    if (with_errors && i % 16 == 15) {
+      // DATA on the connection stream
+      append_frame(out, http2::frame_type::DATA, 0, 0, size(gen));
+      continue;
+    }
+    switch (kind(gen)) {
+    case 0:
+      append_frame(out, http2::frame_type::PING, http2::flags::ACK, 0, 8);
+      break;
+    case 1:
+      append_frame(out, http2::frame_type::WINDOW_UPDATE, 0, stream_id, 4);
+      break;
+    case 2:
+      append_frame(out, http2::frame_type::SETTINGS, http2::flags::ACK, 0, 0);
+      break;
+    case 3:
+      append_frame(out, http2::frame_type::HEADERS, http2::flags::END_HEADERS, stream_id, size(gen));
+      break;
+    case 4:
+      append_frame(out, http2::frame_type::CONTINUATION, http2::flags::END_HEADERS, stream_id, size(gen));
+      break;
+    case 5:
+      append_frame(out, http2::frame_type::RST_STREAM, 0, stream_id, 4);
+      break;
+    default:
+      append_frame(out, http2::frame_type::DATA, http2::flags::END_STREAM, stream_id, size(gen));
+      break;
+    }
+  }
+  return out;
+}
+
+constexpr std::size_t MaxFrameSize = 16384;
+constexpr uint32_t WindowSize = 65535;
+
+// The connection window is accounted for received frames as 'base_client' does
+struct window_accounting {
+  http2::dummy_window window{WindowSize, WindowSize / 4};
+  std::size_t updates = 0;
+
+  void on_received(std::size_t bytes) {
+    window.dec(bytes);
+    if (auto upd = window.update(0)) {
+      ++updates;
+    }
+  }
+};
+
+struct counting_handler {
+  std::size_t payload_bytes = 0;
+
+  template <typename Frame> void operator()(const Frame &frame) { payload_bytes += frame.payload_size(); }
+};
+
+struct result {
+  std::size_t frames = 0;
+  std::size_t window_updates = 0;
+  std::size_t errors = 0;
+  std::size_t bytes = 0;
+  double ns = 0;
+};
+
+// Frame by frame as 'frame_analyzer::parse' does
+result run_single(const std::vector<uint8_t> &stream, std::size_t rounds) {
+  result r;
+  counting_handler handler;
+  window_accounting flow_control;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    std::span<const uint8_t> src = stream;
+    while (src.size() >= http2::frame_analyzer::min_size()) {
+      auto parsed = http2::frame_analyzer::parse(src, MaxFrameSize);
+      // A frame is skipped after an error. A client closes the connection instead
+      auto size = sizeof(http2::header) + http2::frame_analyzer::from_buffer(src).frame_header().payload_size();
+      if (parsed) {
+        flow_control.on_received(size);
+        parsed->visit(handler);
+      } else {
+        ++r.errors;
+      }
+      ++r.frames;
+      src = src.subspan(size);
+    }
+    r.bytes += stream.size();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  r.ns = elapsed.count();
+  r.window_updates = flow_control.updates;
+  if (handler.payload_bytes == 0) {
+    std::fprintf(stderr, "Nothing is processed\n");
+  }
+  return r;
+}
+
+// Split into batches first and then dispatch as 'base_client' does
+result run_batched(const std::vector<uint8_t> &stream, std::size_t rounds) {
+  result r;
+  counting_handler handler;
+  window_accounting flow_control;
+  http2::frame_batch batch;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < rounds; ++i) {
+    std::span<const uint8_t> src = stream;
+    while (src.size() >= http2::frame_analyzer::min_size()) {
+      auto ec = batch.split(src, MaxFrameSize);
+      std::size_t batch_bytes = 0;
+      for (const auto &frame : batch) {
+        frame.visit(handler);
+        batch_bytes += frame.size();
+      }
+      flow_control.on_received(batch_bytes);
+      r.frames += batch.size();
+      if (ec) {
+        // A frame is skipped after an error. A client closes the connection instead
+        batch_bytes += sizeof(http2::header) +
+                       http2::frame_analyzer::from_buffer(src.subspan(batch_bytes)).frame_header().payload_size();
+        ++r.errors;
+        ++r.frames;
+      }
+      src = src.subspan(batch_bytes);
+    }
+    r.bytes += stream.size();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  r.ns = elapsed.count();
+  r.window_updates = flow_control.updates;
+  if (handler.payload_bytes == 0) {
+    std::fprintf(stderr, "Nothing is processed\n");
+  }
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+  if (rounds == 0) {
+    std::fprintf(stderr, "Usage: %s [rounds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::printf("{\n  \"library\": \"h2pp\",\n  \"rounds\": %zu,\n  \"results\": [", rounds);
+  bool first = true;
+  for (bool with_errors : {false, true}) {
+    const auto stream = make_stream(4096, with_errors);
+    for (bool batched : {false, true}) {
+      auto r = batched ? run_batched(stream, rounds) : run_single(stream, rounds);
+      std::printf("%s\n    {\"benchmark\": \"%s\", \"stream\": \"%s\", \"frames\": %zu, \"errors\": %zu, "
+                  "\"window_updates\": %zu, \"ns_per_frame\": %.2f, \"frames_per_second\": %.0f, "
+                  "\"bytes_per_second\": %.0f}",
+                  first ? "" : ",", batched ? "frame_batch_dispatch" : "frame_parse_dispatch",
+                  with_errors ? "mixed_small_with_errors" : "mixed_small", r.frames, r.errors, r.window_updates,
+                  r.ns / r.frames, r.frames * 1e9 / r.ns, r.bytes * 1e9 / r.ns);
+      first = false;
+    }
+  }
+  std::printf("\n  ]\n}\n");
+  return EXIT_SUCCESS;
+}
@@ -4,40 +4,87 @@
 
 #include "hpack/decoder.h"
 #include "hpack/encoder.h"
+#include "utils/coalesce.h"
 
 #include "dummy_window.h"
 #include "error.h"
 #include "frame_builder.h"
+#include "read_buffer_pool.h"
 #include "settings_manager.h"
 #include "stream_registry.h"
 
 namespace http2 {
 
-decltype(&base_client::on_receive_headers) base_client::frame_handlers[] = {
-    &base_client::on_receive_data_not_reachable,
-    &base_client::on_receive_headers,
-    &base_client::on_receive_priority,
-    &base_client::on_receive_reset,
-    &base_client::on_receive_settings,
-    &base_client::on_receive_push,
-    &base_client::on_receive_ping,
-    &base_client::on_receive_goaway,
-    &base_client::on_receive_window_update,
-    &base_client::on_receive_continuation,
+namespace {
+// A max TLS record payload size. Frames of TxSeparateSize bytes or more, like big DATA frames, are not copied
+constexpr std::size_t TxChunkSize = 16 * 1024;
+constexpr std::size_t TxSeparateSize = 4 * 1024;
+
+// Skips fields of unknown streams. They are decoded only to keep the dynamic table in sync
+class discard_sink : public rfc7541::field_sink {
+public:
+  bool accept(std::string_view) override { return false; }
+  void on_field(const rfc7541::header_field_view &) override {}
 };
 
+// Consumed bytes are skipped without moving. Data is moved to the buffer beginning
+// only when the rest of the incomplete frame doesn't fit into the room after it
+void make_room_for_frame(utils::buffer &buff) {
+  const auto data = buff.data_view();
+  const auto frame_size = data.size_bytes() < frame_analyzer::min_size()
+                              ? frame_analyzer::min_size()
+                              : frame_analyzer::from_buffer(data).size();
+  if (buff.prepare().size_bytes() + data.size_bytes() < frame_size) {
+    buff.compact();
+  }
+}
+} // namespace
+
 struct base_client::PrivateClient {
   explicit PrivateClient(boost::asio::io_context &io)
       : settings(io), local_window(http2::INITIAL_WINDOW_SIZE, http2::INITIAL_WINDOW_SIZE / 4) {}
 
   // HPACK
   rfc7541::decoder decoder;
+  discard_sink discarded_fields;
   rfc7541::encoder encoder;
   // Settings
   settings_manager settings;
+  http2::settings local_settings;
   // Stream registry
   stream_registry registry;
   dummy_window local_window;
+  // Slabs of received DATA frames keep the pool
+  std::shared_ptr<read_buffer_pool> read_buffers = std::make_shared<read_buffer_pool>();
+  // A stream that has sent HEADERS without END_HEADERS. Only its CONTINUATION frames are allowed
+  uint32_t continuation_stream = 0;
+
+  boost::system::error_code check_header_block_sequence(const header &frame_header) const {
+    // RFC 7540 6.10. A header block is a contiguous sequence of HEADERS and CONTINUATION frames of one stream
+    bool is_continuation = frame_header.type == frame_type::CONTINUATION;
+    if (continuation_stream != 0 && (!is_continuation || frame_header.stream_id != continuation_stream)) {
+      // A header block is interrupted
+      return make_error_code(error_code::PROTOCOL_ERROR);
+    }
+    if (continuation_stream == 0 && is_continuation) {
+      // Unexpected CONTINUATION frame
+      return make_error_code(error_code::PROTOCOL_ERROR);
+    }
+    return {};
+  }
+
+  boost::system::error_code decode_header_block(uint32_t stream_id, std::span<const uint8_t> block,
+                                                bool end_of_block) {
+    stream::ptr stream_ptr = registry.get_stream(stream_id);
+    rfc7541::field_sink &sink = stream_ptr ? static_cast<rfc7541::field_sink &>(*stream_ptr) : discarded_fields;
+    try {
+      // HPACK reports errors by exceptions. It is the only exception boundary of the receive path
+      decoder.decode(block, sink, end_of_block);
+    } catch (const std ::exception &) {
+      return make_error_code(error_code::COMPRESSION_ERROR);
+    }
+    return {};
+  }
 
   template <typename F, typename... Args> bool invoke_for_stream(uint32_t stream_id, F method, Args... args) {
     stream::ptr stream_ptr = registry.get_stream(stream_id);
@@ -63,108 +110,155 @@ base_client::base_client(boost::asio::io_context &io)
 
 base_client::~base_client() = default;
 
-utils::buffer base_client::on_read(utils::buffer &&io_buff) {
+utils::buffer base_client::on_read(utils::buffer &&io_buff, std::size_t bytes_transferred) {
+  private_client->read_buffers->on_read(bytes_transferred, bytes_transferred + io_buff.prepare().size_bytes());
+
   auto incomming_bytes = io_buff.data_view();
   // TODO: Probably it will be good to check frame length and frame type as early as possible
   //       even when a frame header is not complete.
   if (incomming_bytes.size_bytes() < frame_analyzer::min_size()) {
+    make_room_for_frame(io_buff);
     return io_buff;
   }
 
+  // A slab of received DATA frames is kept till the end, since the rest of data can be in it
+  std::shared_ptr<const utils::buffer> slab;
   std::size_t used_bytes = 0;
+  boost::system::error_code ec;
   try {
-    while (incomming_bytes.size_bytes() >= frame_analyzer::min_size()) {
-
-      auto frame = frame_analyzer::from_buffer(incomming_bytes);
-      frame.check(private_client->settings.get_local_settings().max_frame_size);
-
-      if (frame.is_complete()) {
-        const auto &header = frame.frame_header();
-        if (header.type == frame_type::DATA) {
-          // Optimization. DATA frames will be moved and stored into 'stream' class
-          if (frame.raw_bytes().data() == io_buff.data_view().data() &&
-              frame.raw_bytes().size_bytes() == io_buff.data_view().size_bytes()) {
-            on_receive_data_frame(std::move(io_buff));
-            incomming_bytes = {};
-            break;
-          }
-          auto frame_buff = utils::buffer(frame.raw_bytes().size_bytes());
-          frame_buff.commit(frame.raw_bytes());
-          on_receive_data_frame(std::move(frame_buff));
-        } else {
-          // All other frames are processed on the fly via 'span'.
-          on_receive_frame(frame.raw_bytes());
-        }
-
-        // To the next frame in the io_buffer
-        incomming_bytes = incomming_bytes.subspan(frame.raw_bytes().size_bytes());
-        used_bytes += frame.raw_bytes().size_bytes();
-
-      } else {
-        // a frame is not complete
-        if (io_buff.data_view().size_bytes() + io_buff.prepare().size_bytes() < frame.size()) {
-          auto big_buff = utils::buffer(frame.size());
-          big_buff.commit(frame.raw_bytes());
-          used_bytes = 0;
-          io_buff = std::move(big_buff);
-        }
-        break;
-      }
-    }
+    ec = on_receive_frames(io_buff, slab, incomming_bytes, used_bytes);
   } catch (const boost::system::system_error &ex) {
-    initiate_disconnect(ex.code());
-  } catch (const std::exception & /*ex*/) {
-    initiate_disconnect(error_code::INTERNAL_ERROR);
+    ec = ex.code();
   } catch (...) {
-    initiate_disconnect(error_code::INTERNAL_ERROR);
+    // Protocol violations are returned as error codes. Anything thrown here (e.g. an allocation failure or
+    // an exception of a user callback) must not leave the read handler
+    ec = make_error_code(error_code::INTERNAL_ERROR);
+  }
+  if (ec) {
+    initiate_disconnect(ec);
   }
 
   init_write();
 
   if (incomming_bytes.empty()) {
-    return utils::buffer(64);
+    // A consumed buffer is recycled
+    private_client->read_buffers->release(std::move(io_buff));
+    return private_client->read_buffers->acquire();
+  }
+
+  if (io_buff.max_size() == 0) {
+    // The buffer has become a slab of received DATA frames. The rest is copied to a new buffer
+    auto rest = private_client->read_buffers->acquire(incomming_bytes.size_bytes());
+    rest.commit(incomming_bytes);
+    return rest;
   }
 
   if (used_bytes != 0) {
     io_buff.consume(used_bytes);
   }
+  make_room_for_frame(io_buff);
 
   return io_buff;
 }
 
-void base_client::on_receive_frame(std::span<const uint8_t> data) {
+utils::buffer base_client::acquire_read_buffer() { return private_client->read_buffers->acquire(); }
+
+boost::system::error_code base_client::on_receive_frames(utils::buffer &io_buff,
+                                                         std::shared_ptr<const utils::buffer> &slab,
+                                                         std::span<const uint8_t> &incomming_bytes,
+                                                         std::size_t &used_bytes) {
+  const auto max_frame_size = private_client->settings.get_local_settings().max_frame_size;
+  frame_batch batch;
+  while (incomming_bytes.size_bytes() >= frame_analyzer::min_size()) {
+    // Frames before an invalid one are processed. Then the connection error is returned
+    auto split_ec = batch.split(incomming_bytes, max_frame_size);
+    if (batch.empty()) {
+      if (split_ec) {
+        return split_ec;
+      }
 
-  private_client->local_window.dec(data.size_bytes());
-  auto upd_window = private_client->local_window.update(0);
-  if (upd_window) {
-    send_command(std::move(upd_window.value()));
-  }
+      // The next frame is not complete
+      const auto frame = frame_analyzer::from_buffer(incomming_bytes);
+      if (io_buff.max_size() < frame.size()) {
+        private_client->read_buffers->on_frame_size(frame.size());
+        auto big_buff = private_client->read_buffers->acquire(frame.size());
+        big_buff.commit(frame.raw_bytes());
+        used_bytes = 0;
+        io_buff = std::move(big_buff);
+      }
+      return {};
+    }
 
-  auto fanalyzer = frame_analyzer::from_buffer(data);
-  auto frame_type = static_cast<int>(fanalyzer.frame_header().type);
-  std::invoke(frame_handlers[frame_type], this, data);
+    if (auto ec = on_receive_batch(io_buff, slab, batch, incomming_bytes, used_bytes)) {
+      return ec;
+    }
+    if (split_ec) {
+      return split_ec;
+    }
+  }
+  return {};
 }
 
-void base_client::on_receive_data_frame(utils::buffer &&buff) {
-  private_client->local_window.dec(buff.data_view().size_bytes());
+boost::system::error_code base_client::on_receive_batch(utils::buffer &io_buff,
+                                                        std::shared_ptr<const utils::buffer> &slab,
+                                                        const frame_batch &batch,
+                                                        std::span<const uint8_t> &incomming_bytes,
+                                                        std::size_t &used_bytes) {
+  std::size_t batch_bytes = 0;
+  boost::system::error_code ec;
+  for (const auto &frame : batch) {
+    if ((ec = private_client->check_header_block_sequence(frame.frame_header()))) {
+      break;
+    }
+
+    batch_bytes += frame.raw_bytes().size_bytes();
+    if (frame.frame_header().type == frame_type::DATA) {
+      const auto raw_bytes = frame.raw_bytes();
+      const auto buffer_size = slab ? slab->max_size() : io_buff.max_size();
+      if (raw_bytes.size_bytes() < read_buffer_pool::slice_threshold(buffer_size)) {
+        // A small frame is copied, so it doesn't keep a whole read buffer alive
+        utils::buffer frame_copy(raw_bytes.size_bytes());
+        frame_copy.commit(raw_bytes);
+        on_receive_data(utils::buffer_slice(std::move(frame_copy)));
+      } else {
+        // Other DATA frames are stored into 'stream' class without copying. The read buffer becomes a shared slab.
+        // Its memory is not moved, so spans into the buffer stay valid
+        if (!slab) {
+          slab = private_client->read_buffers->make_slab(std::move(io_buff));
+        }
+        on_receive_data(utils::buffer_slice(slab, raw_bytes));
+      }
+    } else if ((ec = frame.visit([this](const auto &typed_frame) { return on_receive(typed_frame); }))) {
+      // All other frames are processed on the fly
+      break;
+    }
+
+    // To the next frame in the io_buffer
+    incomming_bytes = incomming_bytes.subspan(frame.raw_bytes().size_bytes());
+    used_bytes += frame.raw_bytes().size_bytes();
+  }
+
+  // The connection window is accounted once per batch. So a WINDOW_UPDATE is queued once for many small frames
+  private_client->local_window.dec(batch_bytes);
   auto upd_window = private_client->local_window.update(0);
   if (upd_window) {
     send_command(std::move(upd_window.value()));
   }
-
-  on_receive_data(std::move(buff));
+  return ec;
 }
 
 std::deque<utils::buffer> base_client::get_tx_data() {
 
   // 1. Move command frames
   decltype(tx_command_queue) result;
+  bool window_is_exhausted = false;
   {
     std::scoped_lock lock(command_queue_mutex);
     while (!tx_command_queue.empty()) {
       const auto data = tx_command_queue.front().data_view();
       if (data.size_bytes() > server_window_size) {
-        return result;
+        window_is_exhausted = true;
+        break;
       }
       server_window_size -= data.size_bytes();
       result.emplace_back(std::move(tx_command_queue.front()));
@@ -175,11 +269,12 @@ std::deque<utils::buffer> base_client::get_tx_data() {
   // 2. Move stream frames
   auto limit = std::min(std::size_t(server_window_size),
                         std::size_t(private_client->settings.get_local_settings().max_frame_size));
-  if (limit >= sizeof(header) * 2) {
+  if (!window_is_exhausted && limit >= sizeof(header) * 2) {
     server_window_size -= private_client->registry.get_data(result, private_client->encoder, limit);
   }
 
-  return result;
+  // 3. Small frames are linearized, so a transport doesn't make a TLS record and a syscall for each of them
+  return utils::coalesce(std::move(result), TxChunkSize, TxSeparateSize);
 }
 
 void base_client::cleanup_after_disconnect(const boost::system::error_code &ec) {
@@ -201,12 +296,35 @@ void base_client::write_initial_frames() {
   send_command(std::move(buff));
 }
 
+void base_client::set_local_settings(const http2::settings &s) { private_client->local_settings = s; }
+
+const http2::settings &base_client::get_local_settings() const { return private_client->local_settings; }
+
+rfc7541::atom base_client::register_header_atom(std::string_view name) {
+  return private_client->decoder.add_atom(name);
+}
+
+void base_client::set_huffman_cache(std::shared_ptr<rfc7541::huffman_cache> cache) {
+  auto config = private_client->encoder.get_config();
+  config.string_cache = std::move(cache);
+  private_client->encoder.set_config(config);
+}
+
 void base_client::initiate_sync_settings(
     bool remote_sync, boost::asio::any_completion_handler<void(boost::system::error_code)> &&handler) {
-  http2::settings default_settings;
+  http2::settings local_settings = private_client->local_settings;
 
   auto h = [last = std::move(handler), this](const boost::system::error_code &ec) mutable {
     if (!ec) {
+      // The server knows the new limit since it has acknowledged settings
+      private_client->decoder.set_max_table_size(
+          private_client->settings.get_local_settings().header_table_size);
+      // An encoded field isn't longer than the header list it belongs to
+      auto header_list_size = std::size_t(private_client->settings.get_local_settings().max_header_list_size);
+      if (header_list_size < private_client->decoder.max_field_size()) {
+        private_client->decoder.set_max_field_size(header_list_size);
+      }
+
       // Adjust per session local window size after successfull changing local settings
       auto window_size = private_client->settings.get_local_settings().initial_window_size *
                          private_client->settings.get_local_settings().max_concurrent_streams;
@@ -220,7 +338,7 @@ void base_client::initiate_sync_settings(
     last(ec);
   };
 
-  auto buff = private_client->settings.initiate_sync_settings(std::move(default_settings), remote_sync, std::move(h));
+  auto buff = private_client->settings.initiate_sync_settings(std::move(local_settings), remote_sync, std::move(h));
   send_command(std::move(buff));
   init_write();
 }
@@ -273,57 +391,56 @@ void base_client::initiate_send(
   init_write();
 }
 
-void base_client::on_receive_data(utils::buffer &&buff) {
-  const auto analyzer = frame_analyzer::from_buffer(buff.data_view());
+void base_client::on_receive_data(utils::buffer_slice &&slice) {
+  const auto analyzer = frame_analyzer::from_buffer(slice.data_view());
   const auto &frame = analyzer.get_frame<frame_type::DATA>();
 
-  /*auto processed =*/private_client->invoke_for_stream(frame.stream_id, &stream::on_receive_data, std::move(buff));
+  /*auto processed =*/private_client->invoke_for_stream(frame.stream_id, &stream::on_receive_data, std::move(slice));
 }
 
-void base_client::on_receive_data_not_reachable(std::span<const uint8_t>) {
-  // All frame handler accept an input data as std::span<const uint8_t>
-  // And only DATA frame by optimization reason accepts it via buffer moving.
-  throw boost::system::system_error(make_error_code(error_code::INTERNAL_ERROR), "Unreachable code");
+boost::system::error_code base_client::on_receive(const data_frame &) {
+  // All frame handler accept a frame struct that points into an input data
+  // And only DATA frame by optimization reason accepts it as a slice of the shared input data.
+  return make_error_code(error_code::INTERNAL_ERROR);
 }
 
-void base_client::on_receive_headers(std::span<const uint8_t> data) {
-  const auto analyzer = frame_analyzer::from_buffer(data);
-  const auto &headers_frame = analyzer.get_frame<frame_type::HEADERS>();
+boost::system::error_code base_client::on_receive(const header_frame &headers_frame) {
+  bool end_headers = (headers_frame.flags & flags::END_HEADERS) != 0;
+  private_client->continuation_stream = end_headers ? 0 : uint32_t(headers_frame.stream_id);
 
-  rfc7541::header fields;
-  try {
-    fields = private_client->decoder.decode(headers_frame.header_block());
-  } catch (const std ::exception &ex) {
-    throw boost::system::system_error(make_error_code(error_code::COMPRESSION_ERROR), ex.what());
+  if (auto ec = private_client->decode_header_block(headers_frame.stream_id, headers_frame.header_block(),
+                                                    end_headers)) {
+    return ec;
   }
   /*auto processed =*/private_client->invoke_for_stream(headers_frame.stream_id, &stream::on_receive_headers,
-                                                        std::move(fields), headers_frame.flags, data.size_bytes());
+                                                        headers_frame.flags, headers_frame.raw_bytes().size_bytes());
+  return {};
 }
 
-void base_client::on_receive_priority(std::span<const uint8_t>) {}
-
-void base_client::on_receive_reset(std::span<const uint8_t> data) {
-  const auto analyzer = frame_analyzer::from_buffer(data);
-  const auto &rst_frame = analyzer.get_frame<frame_type::RST_STREAM>();
+boost::system::error_code base_client::on_receive(const priority_frame &) { return {}; }
 
+boost::system::error_code base_client::on_receive(const reset_frame &rst_frame) {
   /*auto processed =*/private_client->invoke_for_stream(rst_frame.stream_id, &stream::on_receive_reset, rst_frame.code);
+  return {};
 }
 
-void base_client::on_receive_settings(std::span<const uint8_t> data) {
-  auto opt_buff = private_client->settings.on_settings_frame(data);
+boost::system::error_code base_client::on_receive(const settings_frame &frame) {
+  auto opt_buff = private_client->settings.on_settings_frame(frame);
   if (opt_buff) {
+    // The encoder follows the peer decoder table size. The next header block is sent after ACK
+    private_client->encoder.set_table_size_limit(private_client->settings.get_server_settings().header_table_size);
     send_command(std::move(opt_buff.value()));
   }
+  return {};
 }
 
-void base_client::on_receive_push(std::span<const uint8_t>) {
+boost::system::error_code base_client::on_receive(const pushpromise_frame &) {
   send_command(frame_builder::goaway(error_code::PROTOCOL_ERROR, 1));
   init_write();
+  return {};
 }
 
-void base_client::on_receive_ping(std::span<const uint8_t> data) {
-  const auto analyzer = frame_analyzer::from_buffer(data);
-  const ping_frame &ping = analyzer.get_frame<frame_type::PING>();
+boost::system::error_code base_client::on_receive(const ping_frame &ping) {
   if ((ping.flags & flags::ACK) != 0) {
     if (ping_handler) {
       decltype(ping_handler) h;
@@ -331,24 +448,22 @@ void base_client::on_receive_ping(std::span<const uint8_t> data) {
       h(boost::system::error_code{});
     }
   } else {
-    utils::buffer ack_buffer(data.size_bytes());
-    ack_buffer.commit(data);
+    utils::buffer ack_buffer(ping.raw_bytes().size_bytes());
+    ack_buffer.commit(ping.raw_bytes());
     auto ack_analyzer = frame_analyzer::from_buffer(ack_buffer.data_view());
     auto &ack_header = ack_analyzer.frame_header();
     const_cast<header &>(ack_header).flags |= flags::ACK;
     send_command(std::move(ack_buffer));
   }
+  return {};
 }
 
-void base_client::on_receive_goaway(std::span<const uint8_t> /*data*/) {
-  //  const auto analyzer = frame_analyzer::from_buffer(data);
-  //  const auto &frame = analyzer.get_frame<frame_type::GOAWAY>();
+boost::system::error_code base_client::on_receive(const goaway_frame & /*frame*/) {
   //  auto additional = frame.additional();
+  return {};
 }
 
-void base_client::on_receive_window_update(std::span<const uint8_t> data) {
-  const auto analyzer = frame_analyzer::from_buffer(data);
-  const auto &frame = analyzer.get_frame<frame_type::WINDOW_UPDATE>();
+boost::system::error_code base_client::on_receive(const window_update_frame &frame) {
   auto size_increment = frame.window_size;
   if (frame.stream_id == 0) {
     server_window_size += size_increment;
@@ -356,21 +471,23 @@ void base_client::on_receive_window_update(std::span<const uint8_t> data) {
     /*auto processed =*/private_client->invoke_for_stream(frame.stream_id, &stream::on_receive_window_update,
                                                           size_increment);
   }
+  return {};
 }
 
-void base_client::on_receive_continuation(std::span<const uint8_t> data) {
-  const auto analyzer = frame_analyzer::from_buffer(data);
-  const auto &continuation_frame = analyzer.get_frame<frame_type::CONTINUATION>();
-
-  rfc7541::header fields;
-  try {
-    fields = private_client->decoder.decode(continuation_frame.header_block());
-  } catch (const std ::exception &ex) {
-    throw boost::system::system_error(make_error_code(error_code::COMPRESSION_ERROR), ex.what());
+boost::system::error_code base_client::on_receive(const continuation_frame &continuation_frame) {
+  bool end_headers = (continuation_frame.flags & flags::END_HEADERS) != 0;
+  if (end_headers) {
+    private_client->continuation_stream = 0;
   }
 
+  if (auto ec = private_client->decode_header_block(continuation_frame.stream_id, continuation_frame.header_block(),
+                                                    end_headers)) {
+    return ec;
+  }
   /*auto processed =*/private_client->invoke_for_stream(continuation_frame.stream_id, &stream::on_receive_continuation,
-                                                        std::move(fields), continuation_frame.flags, data.size_bytes());
+                                                        continuation_frame.flags,
+                                                        continuation_frame.raw_bytes().size_bytes());
+  return {};
 }
 
 } // namespace http2
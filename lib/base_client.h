@@ -10,12 +10,30 @@
 #include <boost/endian/conversion.hpp>
 
 #include "utils/buffer.h"
+#include "utils/buffer_slice.h"
 
+#include "protocol.h"
 #include "request.h"
 #include "response.h"
 
+namespace rfc7541 {
+class huffman_cache;
+}
+
 namespace http2 {
 
+class frame_batch;
+struct data_frame;
+struct header_frame;
+struct priority_frame;
+struct reset_frame;
+struct settings_frame;
+struct pushpromise_frame;
+struct ping_frame;
+struct goaway_frame;
+struct window_update_frame;
+struct continuation_frame;
+
 /**
  * @brief The base_client class contains HTTP2 client implementation
  * that is not depended on transport code
@@ -27,6 +45,25 @@ public:
   base_client(base_client &&) = delete;
   virtual ~base_client();
 
+  /**
+   * @brief set_local_settings sets settings that are sent to a server by the next settings sync.
+   * 'header_table_size' limits the dynamic table that a server uses to compress response headers.
+   */
+  void set_local_settings(const http2::settings &s);
+  const http2::settings &get_local_settings() const;
+
+  /**
+   * @brief register_header_atom registers an extra response header name. @see response::find
+   * Should be called before the first request. Names of the HPACK static table are atoms without registration.
+   */
+  rfc7541::atom register_header_atom(std::string_view name);
+
+  /**
+   * @brief set_huffman_cache sets a cache of Huffman encoded values for request fields that are not indexed.
+   * The same cache can be shared by all clients of a process. Should be called before the first request.
+   */
+  void set_huffman_cache(std::shared_ptr<rfc7541::huffman_cache> cache);
+
 protected:
   // Must be implemented in the parent. Is called every time when a base_client
   // wants to send some data
@@ -45,7 +82,9 @@ protected:
   void initiate_ping(boost::asio::any_completion_handler<void(boost::system::error_code)> &&handler);
 
   // RX/TX methods
-  utils::buffer on_read(utils::buffer &&);
+  utils::buffer acquire_read_buffer();
+  // 'bytes_transferred' is a count of bytes of the last read that are committed into the buffer
+  utils::buffer on_read(utils::buffer &&, std::size_t bytes_transferred);
   void write_initial_frames();
   std::deque<utils::buffer> get_tx_data();
   void cleanup_after_disconnect(const boost::system::error_code &ec);
@@ -63,24 +102,26 @@ protected:
   boost::asio::any_completion_handler<void()> disconnect_handler;
 
 private:
-  // RX/TX methods
-  void on_receive_frame(std::span<const uint8_t>);
-  void on_receive_data_frame(utils::buffer &&);
+  // RX/TX methods. Protocol errors are returned as connection error codes
+  boost::system::error_code on_receive_frames(utils::buffer &io_buff, std::shared_ptr<const utils::buffer> &slab,
+                                              std::span<const uint8_t> &incomming_bytes, std::size_t &used_bytes);
+  boost::system::error_code on_receive_batch(utils::buffer &io_buff, std::shared_ptr<const utils::buffer> &slab,
+                                             const frame_batch &batch, std::span<const uint8_t> &incomming_bytes,
+                                             std::size_t &used_bytes);
   void send_command(utils::buffer &&buff);
 
-  void on_receive_data(utils::buffer &&buff);
-  void on_receive_data_not_reachable(std::span<const uint8_t>);
-  void on_receive_headers(std::span<const uint8_t>);
-  void on_receive_priority(std::span<const uint8_t>);
-  void on_receive_reset(std::span<const uint8_t>);
-  void on_receive_settings(std::span<const uint8_t>);
-  void on_receive_push(std::span<const uint8_t>);
-  void on_receive_ping(std::span<const uint8_t>);
-  void on_receive_goaway(std::span<const uint8_t>);
-  void on_receive_window_update(std::span<const uint8_t>);
-  void on_receive_continuation(std::span<const uint8_t>);
-
-  static decltype(&base_client::on_receive_headers) frame_handlers[];
+  // Frame handlers are chosen by a frame struct type. @see frame_analyzer::visit
+  void on_receive_data(utils::buffer_slice &&slice);
+  boost::system::error_code on_receive(const data_frame &);
+  boost::system::error_code on_receive(const header_frame &);
+  boost::system::error_code on_receive(const priority_frame &);
+  boost::system::error_code on_receive(const reset_frame &);
+  boost::system::error_code on_receive(const settings_frame &);
+  boost::system::error_code on_receive(const pushpromise_frame &);
+  boost::system::error_code on_receive(const ping_frame &);
+  boost::system::error_code on_receive(const goaway_frame &);
+  boost::system::error_code on_receive(const window_update_frame &);
+  boost::system::error_code on_receive(const continuation_frame &);
 
   // Should be 1,3,5,...
   boost::endian::big_uint32_t get_next_stream_id() {
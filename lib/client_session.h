@@ -109,6 +109,7 @@ private:
     connection_error_code = boost::system::error_code{};
 
     write_initial_frames();
+    input_buffer = acquire_read_buffer();
     init_read();
 
     co_await async_update_settings(true, boost::asio::use_awaitable);
@@ -129,7 +130,7 @@ private:
   void on_data_read(const boost::system ::error_code &ec, std::size_t bytes_transferred) {
     if (!ec) {
       input_buffer.commit(bytes_transferred);
-      input_buffer = on_read(std::move(input_buffer));
+      input_buffer = on_read(std::move(input_buffer), bytes_transferred);
       init_read();
     } else if (!start_disconnect_flag.test_and_set()) {
       connection_error_code = ec;
@@ -198,7 +199,8 @@ private:
   ConnectionType connection;
 
   // RX
-  utils::buffer input_buffer = utils::buffer(64);
+  // Is taken from a read buffer pool on connecting
+  utils::buffer input_buffer = utils::buffer(0);
 
   // TX
   std::atomic_flag tx_running_flag;
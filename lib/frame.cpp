@@ -1,6 +1,5 @@
 #include "frame.h"
 
-#include <functional>
 #include <stdexcept>
 
 #include "error.h"
@@ -42,111 +41,131 @@ frame_analyzer frame_analyzer::from_buffer(std::span<const uint8_t> buffer) {
   return frame_analyzer(buffer);
 }
 
-void frame_analyzer::check(std::size_t max_frame_size) const {
-  auto &header = frame_header();
-  if (static_cast<std::size_t>(header.type) > static_cast<std::size_t>(frame_type::CONTINUATION)) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Unknown frame type");
+boost::system::result<frame_analyzer> frame_analyzer::parse(std::span<const uint8_t> buffer,
+                                                           std::size_t max_frame_size) noexcept {
+  if (buffer.size_bytes() < frame_analyzer::min_size()) {
+    return make_error_code(error_code::FRAME_SIZE_ERROR);
   }
 
-  if (header.payload_size() > max_frame_size) {
-    throw boost::system::system_error(error_code::FRAME_SIZE_ERROR, "Overflow payload size");
+  frame_analyzer frame(buffer);
+  if (auto ec = frame.validate(max_frame_size)) {
+    return ec;
   }
+  return frame;
+}
 
-  auto frame_type = static_cast<int>(header.type);
-  std::invoke(check_table[frame_type], this);
+boost::system::error_code frame_batch::split(std::span<const uint8_t> buffer, std::size_t max_frame_size) noexcept {
+  count = 0;
+  while (count < MaxFrames && buffer.size_bytes() >= frame_analyzer::min_size()) {
+    auto frame = frame_analyzer::parse(buffer, max_frame_size);
+    if (frame.has_error()) {
+      return frame.error();
+    }
+    if (!frame->is_complete()) {
+      break;
+    }
+    frames[count++] = frame->raw_bytes();
+    buffer = buffer.subspan(frame->size());
+  }
+  return {};
 }
 
-void frame_analyzer::check_data_frame() const {
-  const data_frame &frame = *reinterpret_cast<const struct data_frame *>(buffer.data());
+namespace {
+bool is_valid_stream_id(uint32_t stream_id) { return !(stream_id & 0x80000000) && stream_id != 0; }
+
+// Frames those aren't checked
+template <typename Frame> boost::system::error_code check_frame(const Frame &) noexcept { return {}; }
+
+boost::system::error_code check_frame(const data_frame &frame) noexcept {
   if (frame.flags & ~flags::DATA_ALLOWED_FLAGS_MASK) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid flag");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
-  if (frame.stream_id & 0x80000000 || frame.stream_id == 0) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid stream ID");
+  if (!is_valid_stream_id(frame.stream_id)) {
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
-  // if (frame.flags & flags::PADDED && frame.padding() ==0){
-  //   throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Padding cannot be 0");
-  // }
+  return {};
 }
 
-void frame_analyzer::check_headers_frame() const {
-  const header_frame &frame = *reinterpret_cast<const struct header_frame *>(buffer.data());
+boost::system::error_code check_frame(const header_frame &frame) noexcept {
   if (frame.flags & ~flags::HEADERS_ALLOWED_FLAGS_MASK) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid flag");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
-  if (frame.stream_id & 0x80000000 || frame.stream_id == 0) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid stream ID");
+  if (!is_valid_stream_id(frame.stream_id)) {
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.payload_size() == 0 && frame.flags & flags::END_HEADERS) {
-    throw boost::system::system_error(error_code::FRAME_SIZE_ERROR, "Unexpected empty frame payload");
+    return make_error_code(error_code::FRAME_SIZE_ERROR);
   }
+  return {};
 }
 
-void frame_analyzer::check_priority_frame() const {}
-
-void frame_analyzer::check_reset_frame() const {}
-
-void frame_analyzer::check_settings_frame() const {
-  const settings_frame &frame = *reinterpret_cast<const struct settings_frame *>(buffer.data());
+boost::system::error_code check_frame(const settings_frame &frame) noexcept {
   if (frame.flags & ~flags::SETTINGS_ALLOWED_FLAGS_MASK) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid flag");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.stream_id != 0) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid stream id");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.payload_size() % sizeof(settings_item) != 0) {
-    throw boost::system::system_error(error_code::FRAME_SIZE_ERROR, "Invalid settings size");
+    return make_error_code(error_code::FRAME_SIZE_ERROR);
   }
+  return {};
 }
 
-void frame_analyzer::check_push_frame() const {
-  throw boost::system::system_error(error_code::INTERNAL_ERROR, "PUSH is not supported");
+boost::system::error_code check_frame(const pushpromise_frame &) noexcept {
+  // PUSH is not supported
+  return make_error_code(error_code::INTERNAL_ERROR);
 }
 
-void frame_analyzer::check_ping_frame() const {
-  const ping_frame &frame = *reinterpret_cast<const struct ping_frame *>(buffer.data());
+boost::system::error_code check_frame(const ping_frame &frame) noexcept {
   if (frame.flags & ~flags::PING_ALLOWED_FLAGS_MASK) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid flag");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.stream_id != 0) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid stream id");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.payload_size() > 64) {
-    throw boost::system::system_error(error_code::FRAME_SIZE_ERROR, "Invalid payload size");
+    return make_error_code(error_code::FRAME_SIZE_ERROR);
   }
+  return {};
 }
 
-void frame_analyzer::check_goaway_frame() const {}
-
-void frame_analyzer::check_window_update_frame() const {
-  const continuation_frame &frame = *reinterpret_cast<const struct continuation_frame *>(buffer.data());
+boost::system::error_code check_frame(const window_update_frame &frame) noexcept {
   if (frame.flags != 0) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid flag");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.stream_id & 0x80000000) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid stream ID");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
+  return {};
 }
 
-void frame_analyzer::check_continuation_frame() const {
-  const continuation_frame &frame = *reinterpret_cast<const struct continuation_frame *>(buffer.data());
+boost::system::error_code check_frame(const continuation_frame &frame) noexcept {
   if (frame.flags & ~flags::CONTINUATION_ALLOWED_FLAGS_MASK) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid flag");
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
-  if (frame.stream_id & 0x80000000 || frame.stream_id == 0) {
-    throw boost::system::system_error(error_code::PROTOCOL_ERROR, "Invalid stream ID");
+  if (!is_valid_stream_id(frame.stream_id)) {
+    return make_error_code(error_code::PROTOCOL_ERROR);
   }
   if (frame.payload_size() == 0 && frame.flags & flags::END_HEADERS) {
-    throw boost::system::system_error(error_code::FRAME_SIZE_ERROR, "Unexpected empty frame payload");
+    return make_error_code(error_code::FRAME_SIZE_ERROR);
   }
+  return {};
 }
+} // namespace
+
+boost::system::error_code frame_analyzer::validate(std::size_t max_frame_size) const noexcept {
+  auto &header = frame_header();
+  if (static_cast<std::size_t>(header.type) > static_cast<std::size_t>(frame_type::CONTINUATION)) {
+    // Unknown frame type
+    return make_error_code(error_code::PROTOCOL_ERROR);
+  }
 
-frame_analyzer::check_ptr frame_analyzer::check_table[] = {
-    &frame_analyzer::check_data_frame,          &frame_analyzer::check_headers_frame,
-    &frame_analyzer::check_priority_frame,      &frame_analyzer::check_reset_frame,
-    &frame_analyzer::check_settings_frame,      &frame_analyzer::check_push_frame,
-    &frame_analyzer::check_ping_frame,          &frame_analyzer::check_goaway_frame,
-    &frame_analyzer::check_window_update_frame, &frame_analyzer::check_continuation_frame,
-};
+  if (header.payload_size() > max_frame_size) {
+    return make_error_code(error_code::FRAME_SIZE_ERROR);
+  }
+
+  return visit([](const auto &frame) { return check_frame(frame); });
+}
 
 } // namespace http2
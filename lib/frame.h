@@ -1,9 +1,11 @@
 #pragma once
 
+#include <array>
 #include <span>
 #include <stdexcept>
 
 #include <boost/endian/arithmetic.hpp>
+#include <boost/system/result.hpp>
 
 #include "error.h"
 #include "protocol.h"
@@ -35,6 +37,14 @@ struct header {
 
   std::size_t payload_size() const { return length.value(); }
 
+  /**
+   * @brief raw_bytes
+   * @return the frame header and the payload
+   */
+  std::span<const uint8_t> raw_bytes() const {
+    return {reinterpret_cast<const uint8_t *>(this), sizeof(*this) + length.value()};
+  }
+
   void set_payload_size(uint32_t size) { length = size; }
 };
 
@@ -149,6 +159,15 @@ public:
    */
   [[nodiscard]] static frame_analyzer from_buffer(std::span<const uint8_t> buffer);
 
+  /**
+   * @brief parse creates a frame_analyzer and validates the frame header with no exceptions.
+   * Only header fields are checked. So a frame can be incomplete.
+   * @param buffer contains raw data. data size must be not less that min_size()
+   * @return a connection error code for an invalid frame
+   */
+  [[nodiscard]] static boost::system::result<frame_analyzer> parse(std::span<const uint8_t> buffer,
+                                                                   std::size_t max_frame_size) noexcept;
+
   /**
    * @brief min_size
    * @return minimal bytes count that can be used for from_buffer call.
@@ -162,9 +181,10 @@ public:
   bool is_complete() const { return size() <= buffer.size_bytes(); }
 
   /**
-   * @brief check throws an exception when a frame is invalid
+   * @brief validate checks the frame header.
+   * @return a connection error code when a frame is invalid or an empty error code
    */
-  void check(std::size_t max_frame_size) const;
+  [[nodiscard]] boost::system::error_code validate(std::size_t max_frame_size) const noexcept;
 
   /**
    * @brief get_frame only for case when a frame is complete
@@ -178,6 +198,36 @@ public:
     return reinterpret_cast<const typename FrameType<type>::type &>(h);
   }
 
+  /**
+   * @brief visit calls 'f' with a reference on a frame struct of the actual frame type.
+   * So a handler is chosen at compile time by an overload resolution.
+   * A frame must be complete and valid. I.e. it has a known type.
+   */
+  template <typename F> decltype(auto) visit(F &&f) const {
+    switch (frame_header().type) {
+    case frame_type::DATA:
+      return f(as<frame_type::DATA>());
+    case frame_type::HEADERS:
+      return f(as<frame_type::HEADERS>());
+    case frame_type::PRIORITY:
+      return f(as<frame_type::PRIORITY>());
+    case frame_type::RST_STREAM:
+      return f(as<frame_type::RST_STREAM>());
+    case frame_type::SETTINGS:
+      return f(as<frame_type::SETTINGS>());
+    case frame_type::PUSH_PROMISE:
+      return f(as<frame_type::PUSH_PROMISE>());
+    case frame_type::PING:
+      return f(as<frame_type::PING>());
+    case frame_type::GOAWAY:
+      return f(as<frame_type::GOAWAY>());
+    case frame_type::WINDOW_UPDATE:
+      return f(as<frame_type::WINDOW_UPDATE>());
+    default:
+      return f(as<frame_type::CONTINUATION>());
+    }
+  }
+
   /**
    * @brief frame_header
    * @return const refernce on frame header struct.
@@ -208,24 +258,66 @@ public:
   std::span<const uint8_t> payload() const { return buffer.subspan(sizeof(struct header)); }
 
 private:
+  friend class frame_batch;
+
   explicit frame_analyzer(std::span<const uint8_t> b);
 
-  void check_data_frame() const;
-  void check_headers_frame() const;
-  void check_priority_frame() const;
-  void check_reset_frame() const;
-  void check_settings_frame() const;
-  void check_push_frame() const;
-  void check_ping_frame() const;
-  void check_goaway_frame() const;
-  void check_window_update_frame() const;
-  void check_continuation_frame() const;
+  template <frame_type type> const typename FrameType<type>::type &as() const noexcept {
+    return *reinterpret_cast<const typename FrameType<type>::type *>(buffer.data());
+  }
 
 private:
-  using check_ptr = decltype(&frame_analyzer::check_data_frame);
-  static check_ptr check_table[];
-
   std::span<const uint8_t> buffer;
 };
 
+/**
+ * @brief The frame_batch class is a view of complete and valid frames at the beginning of raw data.
+ * Received data is split first and then frames are dispatched together,
+ * so per batch work like a flow control accounting is done once for many small frames.
+ */
+class frame_batch {
+public:
+  static constexpr std::size_t MaxFrames = 32;
+
+  class iterator {
+  public:
+    using value_type = frame_analyzer;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(const std::span<const uint8_t> *p) : pos(p) {}
+
+    frame_analyzer operator*() const { return frame_analyzer(*pos); }
+    iterator &operator++() {
+      ++pos;
+      return *this;
+    }
+    iterator operator++(int) {
+      auto prev = *this;
+      ++pos;
+      return prev;
+    }
+    bool operator==(const iterator &) const = default;
+
+  private:
+    const std::span<const uint8_t> *pos = nullptr;
+  };
+
+  /**
+   * @brief split replaces the batch content with up to MaxFrames frames from the beginning of 'buffer'.
+   * It stops at an incomplete frame, at an invalid frame or when the batch is full.
+   * @return a connection error code of the first invalid frame. Frames before it are in the batch.
+   */
+  boost::system::error_code split(std::span<const uint8_t> buffer, std::size_t max_frame_size) noexcept;
+
+  iterator begin() const { return iterator(frames.data()); }
+  iterator end() const { return iterator(frames.data() + count); }
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+private:
+  std::array<std::span<const uint8_t>, MaxFrames> frames;
+  std::size_t count = 0;
+};
+
 } // namespace http2
@@ -112,6 +112,19 @@ utils::buffer continuation(boost::endian::big_uint32_t stream_id, uint8_t flags,
   return buffer;
 }
 
+std::pair<utils::buffer, header *> header_block(frame_type type, boost::endian::big_uint32_t stream_id,
+                                                std::size_t max_payload_size) {
+  utils::buffer buffer(sizeof(header) + max_payload_size);
+  header *frame = reinterpret_cast<header *>(buffer.prepare().data());
+  frame->type = type;
+  frame->flags = 0;
+  frame->stream_id = stream_id;
+  frame->set_payload_size(0);
+
+  buffer.commit(sizeof(header));
+  return {std::move(buffer), frame};
+}
+
 std::pair<utils::buffer, std::span<uint8_t>> data(boost::endian::big_uint32_t stream_id, uint8_t flags,
                                                   uint32_t payload_size) {
   auto size = sizeof(header) + (flags & flags::PADDED ? 1 : 0);
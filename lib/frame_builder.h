@@ -21,6 +21,14 @@ utils::buffer settings_ack();
 utils::buffer headers(boost::endian::big_uint32_t stream_id, uint8_t flags, uint32_t payload_size);
 utils::buffer continuation(boost::endian::big_uint32_t stream_id, uint8_t flags, uint32_t payload_size);
 
+/**
+ * @brief header_block creates a HEADERS or CONTINUATION frame with a room for 'max_payload_size' bytes of a header block.
+ * The frame header is already committed. A caller writes the header block into the buffer,
+ * then sets flags and a payload size via the returned header.
+ */
+std::pair<utils::buffer, header *> header_block(frame_type type, boost::endian::big_uint32_t stream_id,
+                                                std::size_t max_payload_size);
+
 std::pair<utils::buffer, std::span<uint8_t>> data(boost::endian::big_uint32_t stream_id, uint8_t flags,
                                                   uint32_t payload_size);
 } // namespace http2::frame_builder
@@ -0,0 +1,47 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rfc7541 {
+
+arena::~arena() = default;
+
+std::span<uint8_t> arena::allocate(std::size_t size) {
+  while (current < blocks.size()) {
+    auto &b = blocks[current];
+    if (b.size - used >= size) {
+      auto *ptr = b.memory.get() + used;
+      used += size;
+      return {ptr, size};
+    }
+    ++current;
+    used = 0;
+  }
+
+  auto block_size = std::max(size, min_block_size);
+  blocks.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[block_size]), block_size});
+  current = blocks.size() - 1;
+  used = size;
+  return {blocks.back().memory.get(), size};
+}
+
+std::span<const uint8_t> arena::copy(std::span<const uint8_t> src) {
+  if (src.empty()) {
+    return {};
+  }
+  auto dst = allocate(src.size());
+  memcpy(dst.data(), src.data(), src.size());
+  return dst;
+}
+
+void arena::shrink(std::span<uint8_t> last, std::size_t size) noexcept {
+  used -= last.size() - std::min(size, last.size());
+}
+
+void arena::reset() noexcept {
+  current = 0;
+  used = 0;
+}
+
+} // namespace rfc7541
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace rfc7541 {
+
+/**
+ * @brief The arena class is a simple bump allocator for decoded strings.
+ * Memory is allocated by blocks and all allocations are released at once by 'reset'.
+ * Blocks are kept between resets so a steady state decoding doesn't allocate at all.
+ * An allocated memory is stable until the 'reset' call.
+ */
+class arena {
+public:
+  explicit arena(std::size_t block_size = 4096) : min_block_size(block_size) {}
+  arena(const arena &) = delete;
+  arena &operator=(const arena &) = delete;
+  arena(arena &&) = default;
+  arena &operator=(arena &&) = default;
+  ~arena();
+
+  /**
+   * @brief allocate returns a new uninitialized memory slice of the given size.
+   */
+  std::span<uint8_t> allocate(std::size_t size);
+
+  /**
+   * @brief copy allocates a memory and copies a given data into it.
+   */
+  std::span<const uint8_t> copy(std::span<const uint8_t> src);
+
+  /**
+   * @brief shrink gives back an unused tail of the last allocation.
+   * @param last is the last allocated slice
+   * @param size is a new size of the last allocation. Must be not greater than the original one
+   */
+  void shrink(std::span<uint8_t> last, std::size_t size) noexcept;
+
+  /**
+   * @brief reset releases all allocated slices but keeps the memory for the next usage.
+   */
+  void reset() noexcept;
+
+private:
+  struct block {
+    std::unique_ptr<uint8_t[]> memory;
+    std::size_t size;
+  };
+
+  std::size_t min_block_size;
+  std::vector<block> blocks;
+  std::size_t current = 0;
+  std::size_t used = 0;
+};
+
+} // namespace rfc7541
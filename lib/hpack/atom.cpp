@@ -0,0 +1,42 @@
+#include "atom.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "static_table.h"
+
+namespace rfc7541 {
+
+atom atom_table::add(std::string_view name) {
+  if (name.empty()) {
+    throw std::invalid_argument("An empty header name can't be an atom");
+  }
+  if (auto a = find({reinterpret_cast<const uint8_t *>(name.data()), name.size()}); a != atoms::none) {
+    return a;
+  }
+  if (size() > std::numeric_limits<atom>::max()) {
+    throw std::invalid_argument("Too many header atoms");
+  }
+  extra_names.emplace_back(name);
+  return static_cast<atom>(size() - 1);
+}
+
+atom atom_table::find(std::span<const uint8_t> name) const noexcept {
+  if (auto i = static_table::name_index(name); i > 0) {
+    return static_cast<atom>(i);
+  }
+  for (std::size_t i = 0; i < extra_names.size(); ++i) {
+    const auto &extra = extra_names[i];
+    if (extra.size() == name.size() && 0 == memcmp(extra.data(), name.data(), name.size())) {
+      return static_cast<atom>(atoms::first_extra + i);
+    }
+  }
+  return atoms::none;
+}
+
+atom atom_table::find_static(std::size_t index) noexcept {
+  return static_cast<atom>(static_table::first_name_index(index));
+}
+
+} // namespace rfc7541
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rfc7541 {
+
+/**
+ * @brief atom is a small integer id of a well known header name.
+ * A name of the static table is an atom equal to the first static table index with this name.
+ * Extra names registered in an 'atom_table' get ids that follow the static table. 0 means no atom.
+ */
+using atom = uint16_t;
+
+namespace atoms {
+constexpr atom none = 0;
+constexpr atom authority = 1;
+constexpr atom method = 2;
+constexpr atom path = 4;
+constexpr atom scheme = 6;
+constexpr atom status = 8;
+constexpr atom accept_encoding = 16;
+constexpr atom accept = 19;
+constexpr atom cache_control = 24;
+constexpr atom content_encoding = 26;
+constexpr atom content_length = 28;
+constexpr atom content_type = 31;
+constexpr atom date = 33;
+constexpr atom etag = 34;
+constexpr atom last_modified = 44;
+constexpr atom location = 46;
+constexpr atom retry_after = 53;
+constexpr atom server = 54;
+constexpr atom set_cookie = 55;
+constexpr atom vary = 59;
+
+// Extra atoms start from here
+constexpr atom first_extra = 62;
+} // namespace atoms
+
+/**
+ * @brief The atom_table class maps header names into atoms.
+ * Static table names are resolved by the static table index. Extra names are registered by 'add'.
+ * @note Names are compared as is. HTTP/2 header names are lowercase.
+ */
+class atom_table {
+public:
+  atom_table() = default;
+  atom_table(const atom_table &) = default;
+  atom_table &operator=(const atom_table &) = default;
+  atom_table(atom_table &&) = default;
+  atom_table &operator=(atom_table &&) = default;
+  ~atom_table() = default;
+
+  /**
+   * @brief add registers an extra name.
+   * @return an atom of the name. A static table name or an already registered name keeps its atom
+   * @throw std::invalid_argument for an empty name or when there are too many names
+   */
+  atom add(std::string_view name);
+
+  /**
+   * @brief find
+   * @return an atom of a given name or 'atoms::none'
+   */
+  atom find(std::span<const uint8_t> name) const noexcept;
+
+  /**
+   * @brief find_static
+   * @return an atom of a static table entry name. 'index' must be a valid static table index
+   */
+  static atom find_static(std::size_t index) noexcept;
+
+  /**
+   * @brief size
+   * @return an upper bound of atom values. I.e. all atoms are less than it
+   */
+  std::size_t size() const noexcept { return atoms::first_extra + extra_names.size(); }
+
+private:
+  std::vector<std::string> extra_names;
+};
+
+} // namespace rfc7541
@@ -1,6 +1,8 @@
 #include "decoder.h"
 
+#include <algorithm>
 #include <functional>
+#include <stdexcept>
 
 #include "constants.h"
 #include "integer.h"
@@ -27,13 +29,115 @@ command decode_cmd(uint8_t byte) {
     return command::LITERAL_NEVER_INDEX;
   }
 }
+
+std::string_view as_string_view(std::span<const uint8_t> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+class view_collector : public field_sink {
+public:
+  explicit view_collector(header_view &fields) : fields(fields) {}
+
+  void on_field(const header_field_view &field) override { fields.push_back(field); }
+
+private:
+  header_view &fields;
+};
 } // namespace
 
+decoder::decoder(std::size_t max_table_size) { set_max_table_size(max_table_size); }
+
 decoder::~decoder() = default;
 
-header decoder::decode(std::span<const uint8_t> src) {
-  // using cmd_ptr = void (decoder::*)(ibitstream &stream, header &);
-  using cmd_ptr = std::span<const uint8_t> (decoder::*)(std::span<const uint8_t>, header &);
+void decoder::set_max_table_size(std::size_t limit) {
+  table_size_limit = limit;
+  size_update_required = table.max_size() > limit;
+}
+
+header decoder::decode(std::span<const uint8_t> src, bool end_of_block) {
+  views.clear();
+  decode(src, views, end_of_block);
+
+  header fields;
+  fields.reserve(views.size());
+  for (const auto &v : views) {
+    fields.emplace_back(v);
+  }
+  return fields;
+}
+
+void decoder::decode(std::span<const uint8_t> src, header_view &fields, bool end_of_block) {
+  view_collector collector(fields);
+  stable_views = true;
+  decode_block(src, collector, end_of_block);
+}
+
+void decoder::decode(std::span<const uint8_t> src, field_sink &sink, bool end_of_block) {
+  stable_views = false;
+  decode_block(src, sink, end_of_block);
+}
+
+void decoder::decode_block(std::span<const uint8_t> src, field_sink &sink, bool end_of_block) {
+  storage.reset();
+
+  if (!pending.empty()) {
+    src = decode_pending(src, sink);
+  }
+
+  while (!src.empty()) {
+    try {
+      src = decode_field(src, sink);
+    } catch (const incomplete_input &) {
+      // The field is continued by the next fragment. Nothing is emitted or inserted before a field is complete
+      append_pending(src);
+      break;
+    }
+  }
+
+  if (end_of_block) {
+    block_started = false;
+  }
+  if (end_of_block && !pending.empty()) {
+    pending.clear();
+    throw std::invalid_argument("A header block ends in the middle of a field");
+  }
+}
+
+std::span<const uint8_t> decoder::decode_pending(std::span<const uint8_t> src, field_sink &sink) {
+  constexpr std::size_t MinGrowth = 64;
+  while (!src.empty()) {
+    // Growing by doubling keeps copying linear for long literals and short for small fields
+    auto prev_size = pending.size();
+    auto len = std::min(src.size(), std::max(prev_size, MinGrowth));
+    append_pending(src.first(len));
+
+    std::span<const uint8_t> rest;
+    try {
+      rest = decode_field(pending, sink);
+    } catch (const incomplete_input &) {
+      src = src.subspan(len);
+      continue;
+    }
+
+    // Views of the field stay in 'split_field' since 'pending' is reused by the next split field
+    auto used = pending.size() - rest.size();
+    split_field.swap(pending);
+    pending.clear();
+    return src.subspan(used - prev_size);
+  }
+  return src;
+}
+
+void decoder::append_pending(std::span<const uint8_t> src) {
+  if (pending.size() + src.size() > field_size_limit) {
+    pending.clear();
+    throw std::invalid_argument("A split header field exceeds the size limit");
+  }
+  pending.insert(pending.end(), src.begin(), src.end());
+}
+
+std::span<const uint8_t> decoder::decode_field(std::span<const uint8_t> src, field_sink &sink) {
+  using cmd_ptr = std::span<const uint8_t> (decoder::*)(std::span<const uint8_t>, field_sink &);
   static cmd_ptr commands[] = {
       &decoder::index_cmd,
       &decoder::literal_incremental_index_cmd,
@@ -42,70 +146,119 @@ header decoder::decode(std::span<const uint8_t> src) {
       &decoder::literal_never_index_cmd,
   };
 
-  header fields;
+  auto cmd = decode_cmd(src.front());
+  if (cmd == command::CHANGE_TABLE_SIZE) {
+    if (block_started) {
+      throw std::invalid_argument("A dynamic table size update follows a header field");
+    }
+  } else {
+    if (size_update_required) {
+      throw std::invalid_argument("A dynamic table size update is expected");
+    }
+    block_started = true;
+  }
+  return std::invoke(commands[static_cast<unsigned>(cmd)], this, src, sink);
+}
 
-  while (!src.empty()) {
-    auto cmd = decode_cmd(src.front());
-    src = std::invoke(commands[static_cast<unsigned>(cmd)], this, src, fields);
+std::span<const uint8_t> decoder::keep(std::size_t index, std::span<const uint8_t> data) {
+  if (index <= static_table::size()) {
+    // Static table entries live forever
+    return data;
   }
+  // Dynamic table entries can be evicted by the next fields of the same block
+  return storage.copy(data);
+}
 
-  return fields;
+atom decoder::name_atom(std::size_t index, std::span<const uint8_t> name) const noexcept {
+  if (index != 0 && index <= static_table::size()) {
+    return atom_table::find_static(index);
+  }
+  return atom_names.find(name);
 }
 
-std::span<const uint8_t> decoder::index_cmd(std::span<const uint8_t> src, header &header) {
+std::span<const uint8_t> decoder::index_cmd(std::span<const uint8_t> src, field_sink &sink) {
   auto index = integer::decode(cmd_info::get(command::INDEX).bitlen, src);
   if (index.value == 0) {
     throw std::runtime_error("Invalid index value");
   }
   const auto [name, value] = table.at(index.value);
-  header.emplace_back(name, value);
+  if (sink.accept(as_string_view(name))) {
+    auto a = name_atom(index.value, name);
+    if (stable_views) {
+      sink.on_field({keep(index.value, name), keep(index.value, value), index_type::DEFAULT, false, a});
+    } else {
+      sink.on_field({name, value, index_type::DEFAULT, false, a});
+    }
+  }
   return src.subspan(index.used_bytes);
 }
 
-std::span<const uint8_t> decoder::change_table_size_cmd(std::span<const uint8_t> src, header & /*h*/) {
+std::span<const uint8_t> decoder::change_table_size_cmd(std::span<const uint8_t> src, field_sink & /*sink*/) {
   auto max_size = integer::decode(cmd_info::get(command::CHANGE_TABLE_SIZE).bitlen, src);
+  if (max_size.value > table_size_limit) {
+    throw std::invalid_argument("A dynamic table size update exceeds the limit");
+  }
   table.update_size(max_size.value);
+  size_update_required = false;
   return src.subspan(max_size.used_bytes);
 }
 
-std::span<const uint8_t> decoder::literal_without_index_cmd(std::span<const uint8_t> src, header &h) {
-  return literal_without_index_impl(src, h, index_type::WITHOUT_INDEX,
-                                    cmd_info::get(command::LITERAL_WITHOUT_INDEX).bitlen);
+std::span<const uint8_t> decoder::literal_without_index_cmd(std::span<const uint8_t> src, field_sink &sink) {
+  return literal_impl(src, sink, index_type::WITHOUT_INDEX, cmd_info::get(command::LITERAL_WITHOUT_INDEX).bitlen);
 }
 
-std::span<const uint8_t> decoder::literal_never_index_cmd(std::span<const uint8_t> src, header &h) {
-  return literal_without_index_impl(src, h, index_type::NEVER_INDEX,
-                                    cmd_info::get(command::LITERAL_NEVER_INDEX).bitlen);
+std::span<const uint8_t> decoder::literal_never_index_cmd(std::span<const uint8_t> src, field_sink &sink) {
+  return literal_impl(src, sink, index_type::NEVER_INDEX, cmd_info::get(command::LITERAL_NEVER_INDEX).bitlen);
 }
 
-std::span<const uint8_t> decoder::literal_incremental_index_cmd(std::span<const uint8_t> src, header &h) {
-  auto res =
-      literal_without_index_impl(src, h, index_type::DEFAULT, cmd_info::get(command::LITERAL_INCREMENTAL_INDEX).bitlen);
-  table.insert(h.back().name(), h.back().value());
-  return res;
+std::span<const uint8_t> decoder::literal_incremental_index_cmd(std::span<const uint8_t> src, field_sink &sink) {
+  return literal_impl(src, sink, index_type::DEFAULT, cmd_info::get(command::LITERAL_INCREMENTAL_INDEX).bitlen);
 }
 
-std::span<const uint8_t> decoder::literal_without_index_impl(std::span<const uint8_t> src, header &h, index_type type,
-                                                             uint8_t bits) {
+std::span<const uint8_t> decoder::literal_impl(std::span<const uint8_t> src, field_sink &sink, index_type type,
+                                               uint8_t bits) {
   auto index = integer::decode(bits, src);
   src = src.subspan(index.used_bytes);
 
-  std::vector<uint8_t> name;
+  std::span<const uint8_t> name;
   if (index.value == 0) {
-    auto decoded_name = string::decode(src);
+    auto decoded_name = string::decode(src, storage);
     src = src.subspan(decoded_name.used_bytes);
-    name = std::move(decoded_name.value);
+    name = decoded_name.value;
   } else {
-    const auto [name_view, value_view] = table.at(index.value);
-    std::ignore = value_view;
-    name = std::vector<uint8_t>(name_view.begin(), name_view.end());
+    name = table.at(index.value).first;
   }
 
-  std::vector<uint8_t> value;
-  auto decoded_value = string::decode(src);
-  src = src.subspan(decoded_value.used_bytes);
-  h.emplace_back(std::move(name), std::move(decoded_value.value), type);
-  return src;
+  // A field split across fragments is decoded again with the next fragment. So the whole value is checked first
+  // to call 'accept' once per field
+  const auto value_size = string::skip(src);
+  bool accepted = sink.accept(as_string_view(name));
+  bool indexed = type == index_type::DEFAULT;
+  if (!accepted && !indexed) {
+    return src.subspan(value_size);
+  }
+
+  auto a = accepted ? name_atom(index.value, name) : atoms::none;
+  if (index.value != 0 && (stable_views || indexed)) {
+    // A dynamic table entry can't be inserted into the table from itself
+    name = keep(index.value, name);
+  }
+
+  if (!indexed && sink.accepts_huffman()) {
+    // The value isn't inserted into the table. So a sink may decode it later or never
+    auto raw_value = string::read_encoded(src);
+    sink.on_field({name, raw_value.value, type, raw_value.is_huffman, a});
+    return src.subspan(raw_value.used_bytes);
+  }
+
+  auto decoded_value = string::decode(src, storage);
+  if (accepted) {
+    sink.on_field({name, decoded_value.value, type, false, a});
+  }
+  if (indexed) {
+    table.insert(name, decoded_value.value);
+  }
+  return src.subspan(decoded_value.used_bytes);
 }
 
 } // namespace rfc7541
@@ -1,37 +1,153 @@
 #pragma once
-;
+
 #include <cstdint>
 #include <span>
+#include <string_view>
+#include <vector>
 
+#include "arena.h"
+#include "atom.h"
 #include "header_field.h"
 #include "hpack_table.h"
 
 namespace rfc7541 {
 
-class ibitstream;
+/**
+ * @brief The field_sink class receives decoded header fields one by one.
+ * It allows to skip not interesting fields before their values are decoded.
+ */
+class field_sink {
+public:
+  virtual ~field_sink() = default;
+
+  /**
+   * @brief accept is called when a field name is known and its value isn't decoded yet.
+   * It is called once per field even if the field is split across fragments.
+   * @return false to skip the field. A skipped field isn't materialized.
+   */
+  virtual bool accept(std::string_view /*name*/) { return true; }
+
+  /**
+   * @brief accepts_huffman
+   * @return true if not indexed values can be passed Huffman encoded. @see header_field_view::is_huffman
+   */
+  virtual bool accepts_huffman() const { return false; }
+
+  /**
+   * @brief on_field is called for every accepted field.
+   * @note A view is valid only during the call.
+   */
+  virtual void on_field(const header_field_view &field) = 0;
+};
 
 class decoder {
 public:
   decoder() = default;
+  /**
+   * @brief decoder creates a decoder that allows a peer encoder to use a dynamic table up to 'max_table_size' bytes.
+   * @note The table starts at the HTTP/2 default size until the peer signals another one.
+   */
+  explicit decoder(std::size_t max_table_size);
   decoder(const decoder &) = delete;
   decoder &operator=(const decoder &) = delete;
   decoder(decoder &&) = delete;
   decoder &operator=(decoder &&) = delete;
   ~decoder();
 
-  header decode(std::span<const uint8_t> encoded_data);
+  /**
+   * @brief decode decodes a header block fragment into owning header fields.
+   */
+  header decode(std::span<const uint8_t> encoded_data, bool end_of_block = true);
+
+  /**
+   * @brief decode decodes a header block fragment into non-owning views with no per field allocations.
+   * A header block can be split into fragments at any byte (HEADERS and CONTINUATION frames).
+   * Fields that are complete in the fragment are decoded in place. Only a field that is split by a fragment
+   * boundary is kept by the decoder and it is finished by the next fragment.
+   * @param encoded_data is a header block fragment
+   * @param fields is an output list. Decoded fields are appended to it.
+   * @param end_of_block is true for the last fragment of a header block
+   * @throw std::invalid_argument when the last fragment ends in the middle of a field or a split field is longer
+   * than max_field_size
+   * @note All views are valid while 'encoded_data' is alive and until the next decode call.
+   */
+  void decode(std::span<const uint8_t> encoded_data, header_view &fields, bool end_of_block = true);
+
+  /**
+   * @brief decode decodes a header block fragment and passes fields into a given sink.
+   * Values of skipped fields are not decoded unless they have to be inserted into the dynamic table.
+   * Fragments are processed as in the 'header_view' version.
+   */
+  void decode(std::span<const uint8_t> encoded_data, field_sink &sink, bool end_of_block = true);
+
+  /**
+   * @brief has_pending
+   * @return true when a header block is not finished and a field waits for the next fragment
+   */
+  bool has_pending() const noexcept { return !pending.empty(); }
+
+  /**
+   * @brief set_max_table_size sets a limit for dynamic table size updates (the local SETTINGS_HEADER_TABLE_SIZE).
+   * When the current table is larger the next header block must start with a size update.
+   */
+  void set_max_table_size(std::size_t limit);
+  std::size_t max_table_size() const noexcept { return table_size_limit; }
+
+  /**
+   * @brief set_max_field_size limits a size of an encoded field that is split by a fragment boundary.
+   * Such a field is buffered by the decoder, so the limit bounds memory that a peer can make it keep.
+   */
+  void set_max_field_size(std::size_t limit) noexcept { field_size_limit = limit; }
+  std::size_t max_field_size() const noexcept { return field_size_limit; }
+
+  /**
+   * @brief table_size
+   * @return a current dynamic table size that is set by the peer encoder
+   */
+  std::size_t table_size() const { return table.max_size(); }
+
+  /**
+   * @brief add_atom registers an extra header name. Decoded fields with this name get the returned atom.
+   * Names of the static table are atoms without registration. @see header_field_view::name_atom
+   */
+  atom add_atom(std::string_view name) { return atom_names.add(name); }
+  const atom_table &get_atoms() const noexcept { return atom_names; }
 
 private:
   constexpr static inline size_t DefaultTableSize = 4096;
+  constexpr static inline size_t DefaultFieldSizeLimit = 64 * 1024;
   decoder_table table{DefaultTableSize};
+  std::size_t table_size_limit = DefaultTableSize;
+  std::size_t field_size_limit = DefaultFieldSizeLimit;
+  // RFC 7541 4.2. Size updates are allowed only at the beginning of a header block
+  bool block_started = false;
+  bool size_update_required = false;
+  // Keeps Huffman decoded strings and copies of dynamic table entries for the last decoded block
+  arena storage;
+  header_view views;
+  // The beginning of a field that is split by a fragment boundary
+  std::vector<uint8_t> pending;
+  // The last field decoded from 'pending'. Its views are valid until the next decode call
+  std::vector<uint8_t> split_field;
+  atom_table atom_names;
+
+  // Views passed into a sink must be valid until the next decode call
+  bool stable_views = false;
+
+  void decode_block(std::span<const uint8_t> src, field_sink &sink, bool end_of_block);
+  std::span<const uint8_t> decode_pending(std::span<const uint8_t> src, field_sink &sink);
+  void append_pending(std::span<const uint8_t> src);
+  std::span<const uint8_t> decode_field(std::span<const uint8_t> src, field_sink &sink);
+
+  std::span<const uint8_t> index_cmd(std::span<const uint8_t> src, field_sink &sink);
+  std::span<const uint8_t> change_table_size_cmd(std::span<const uint8_t> src, field_sink &sink);
+  std::span<const uint8_t> literal_without_index_cmd(std::span<const uint8_t> src, field_sink &sink);
+  std::span<const uint8_t> literal_never_index_cmd(std::span<const uint8_t> src, field_sink &sink);
+  std::span<const uint8_t> literal_incremental_index_cmd(std::span<const uint8_t> src, field_sink &sink);
+  std::span<const uint8_t> literal_impl(std::span<const uint8_t> src, field_sink &sink, index_type type, uint8_t bits);
 
-  std::span<const uint8_t> index_cmd(std::span<const uint8_t> src, header &h);
-  std::span<const uint8_t> change_table_size_cmd(std::span<const uint8_t> src, header &h);
-  std::span<const uint8_t> literal_without_index_cmd(std::span<const uint8_t> src, header &h);
-  std::span<const uint8_t> literal_never_index_cmd(std::span<const uint8_t> src, header &h);
-  std::span<const uint8_t> literal_without_index_impl(std::span<const uint8_t> src, header &h, index_type type,
-                                                      uint8_t bits);
-  std::span<const uint8_t> literal_incremental_index_cmd(std::span<const uint8_t> src, header &h);
+  std::span<const uint8_t> keep(std::size_t index, std::span<const uint8_t> data);
+  atom name_atom(std::size_t index, std::span<const uint8_t> name) const noexcept;
 };
 
 } // namespace rfc7541
@@ -1,14 +1,28 @@
 #include "dynamic_table.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstring>
 #include <stdexcept>
 
 namespace rfc7541 {
 
+namespace {
+constexpr std::size_t EntryOverhead = 32;
+} // namespace
+
+dynamic_table::dynamic_table(std::size_t max_size) : hpack_max_size(max_size) { reserve(max_size); }
+
+dynamic_table::~dynamic_table() = default;
+
+std::size_t dynamic_table::entries_capacity(std::size_t max_size) {
+  // Every entry takes at least 32 bytes so there are no more than max_size / 32 entries
+  return std::bit_ceil(std::max<std::size_t>(max_size / EntryOverhead, 1));
+}
+
 std::pair<std::span<const uint8_t>, std::span<const uint8_t>> dynamic_table::at(std::size_t i) const {
-  if (i <= table.size()) {
-    const auto &record = table[i - 1];
-    return {record.name, record.value};
+  if (i != 0 && i <= count) {
+    return fields(entry_by_id(inserted - i));
   }
 
   // FIXME: offset
@@ -16,53 +30,70 @@ std::pair<std::span<const uint8_t>, std::span<const uint8_t>> dynamic_table::at(
 }
 
 void dynamic_table::insert(const std::span<const uint8_t> name, const std::span<const uint8_t> value) {
-  record r{};
-  r.name.assign(name.begin(), name.end());
-  r.value.assign(value.begin(), value.end());
-  auto hsize = r.hpack_size();
-
-  auto rq_size = ((hsize + table_size) > hpack_max_size) ? hpack_max_size - hsize : hsize + table_size;
-  table.erase(shrink_to(rq_size), table.end());
+  insert(name, value, [](uint64_t) {});
+}
 
-  insert_impl(std::move(r));
+void dynamic_table::update_size(std::size_t size) {
+  update_size(size, [](uint64_t) {});
 }
 
-void dynamic_table::insert_impl(record &&r) {
-  unsigned index = 0;
-  if (!table.empty()) {
-    index = table.front().init_index + 1;
+void dynamic_table::push(std::span<const uint8_t> name, std::span<const uint8_t> value) {
+  auto len = name.size() + value.size();
+  if (storage_size - (data_end - shift) < len) {
+    // Move the live region to the front. It always has a room after that since
+    // a live region size + len is not greater than hpack_max_size - 32 * entries count
+    memmove(storage.get(), storage.get() + (data_begin - shift), data_end - data_begin);
+    shift = data_begin;
   }
 
-  r.init_index = index;
-  auto hsize = r.hpack_size();
-  table.push_front(std::move(r));
-  table_size += hsize;
-}
+  auto *dst = storage.get() + (data_end - shift);
+  if (!name.empty()) {
+    memcpy(dst, name.data(), name.size());
+  }
+  if (!value.empty()) {
+    memcpy(dst + name.size(), value.data(), value.size());
+  }
 
-void dynamic_table::update_size(std::size_t size) {
-  table.erase(shrink_to(size), table.end());
-  hpack_max_size = size;
+  entries[inserted & entries_mask] = {data_end, static_cast<uint32_t>(name.size()),
+                                      static_cast<uint32_t>(value.size())};
+  data_end += len;
+  ++inserted;
+  ++count;
+  table_size += len + EntryOverhead;
 }
 
-dynamic_table::table_iterator dynamic_table::shrink_to(std::size_t rq_size) {
-  if (table_size <= rq_size) {
-    return table.end();
-  }
-
-  auto eviction_size = table_size - rq_size;
-  auto it = table.end();
-  do {
-    it--;
-    auto sz = it->hpack_size();
-    eviction_size -= sz;
-    table_size -= sz;
-  } while (it != table.begin() && eviction_size > 0);
+void dynamic_table::pop() noexcept {
+  const auto &e = entry_by_id(oldest_id());
+  data_begin += e.name_size + e.value_size;
+  table_size -= e.hpack_size();
+  --count;
 
-  return it;
+  if (count == 0) {
+    // Nothing to move. Start from the storage beginning
+    shift = data_begin = data_end;
+  }
 }
 
-std::size_t dynamic_table::record_index(const record *r) const {
-  return table.size() + table.back().init_index - r->init_index;
+void dynamic_table::reserve(std::size_t size) {
+  if (size > storage_size) {
+    std::unique_ptr<uint8_t[]> new_storage(new uint8_t[size]);
+    if (data_end != data_begin) {
+      memcpy(new_storage.get(), storage.get() + (data_begin - shift), data_end - data_begin);
+    }
+    storage = std::move(new_storage);
+    storage_size = size;
+    shift = data_begin;
+  }
+
+  auto capacity = entries_capacity(size);
+  if (capacity > entries_mask + 1 || !entries) {
+    std::unique_ptr<entry[]> new_entries(new entry[capacity]);
+    for (auto id = oldest_id(); id != inserted; ++id) {
+      new_entries[id & (capacity - 1)] = entry_by_id(id);
+    }
+    entries = std::move(new_entries);
+    entries_mask = capacity - 1;
+  }
 }
 
 } // namespace rfc7541
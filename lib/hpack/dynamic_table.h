@@ -1,41 +1,115 @@
 #pragma once
 
 #include <cstdint>
-#include <deque>
+#include <memory>
 #include <span>
-#include <vector>
+#include <utility>
 
 namespace rfc7541 {
 
+/**
+ * @brief The dynamic_table class is a HPACK dynamic table.
+ * All entries are stored in a single preallocated byte storage of 'max_size' bytes.
+ * New entries are appended at the end of the live region and evicted from its beginning.
+ * When a new entry doesn't fit into the tail of the storage the live region is moved to the front.
+ * The HPACK size of every entry has 32 bytes of overhead so the live region always fits the storage.
+ * Entries are described by a compact ring of 'entry' structs. So insertion and eviction never allocate.
+ * The storage grows only when 'update_size' sets a size that is greater than ever before.
+ *
+ * @note 'insert' arguments must not point into the table itself.
+ */
 class dynamic_table {
 public:
-  explicit dynamic_table(std::size_t max_size) : hpack_max_size(max_size) {}
+  explicit dynamic_table(std::size_t max_size);
 
   dynamic_table() = delete;
   dynamic_table(const dynamic_table &) = delete;
   dynamic_table(dynamic_table &&) = default;
-  ~dynamic_table() = default;
+  ~dynamic_table();
 
   std::pair<std::span<const uint8_t>, std::span<const uint8_t>> at(std::size_t i) const;
   void insert(const std::span<const uint8_t> name, const std::span<const uint8_t> value);
   void update_size(std::size_t size);
   std::size_t max_size() const { return hpack_max_size; }
 
+  /**
+   * @brief size
+   * @return a count of entries
+   */
+  std::size_t size() const noexcept { return count; }
+
 protected:
-  struct record {
-    std::vector<uint8_t> name;
-    std::vector<uint8_t> value;
-    unsigned init_index = 0;
+  struct entry {
+    // A virtual offset of the entry in the storage. Value follows name
+    uint64_t offset;
+    uint32_t name_size;
+    uint32_t value_size;
 
-    std::size_t hpack_size() const { return name.size() + value.size() + 32; }
+    std::size_t hpack_size() const { return std::size_t(name_size) + value_size + 32; }
   };
+
+  // A power of 2 capacity of a ring that keeps all entries of a given table size
+  static std::size_t entries_capacity(std::size_t max_size);
+
+  // Every entry has an unique id. Ids are growing with every insertion
+  uint64_t oldest_id() const noexcept { return inserted - count; }
+  uint64_t newest_id() const noexcept { return inserted - 1; }
+  std::size_t id_to_index(uint64_t id) const noexcept { return inserted - id; }
+  const entry &entry_by_id(uint64_t id) const noexcept { return entries[id & entries_mask]; }
+  std::pair<std::span<const uint8_t>, std::span<const uint8_t>> fields(const entry &e) const noexcept {
+    const auto *name = storage.get() + (e.offset - shift);
+    return {{name, e.name_size}, {name + e.name_size, e.value_size}};
+  }
+
+  template <typename F> void evict(std::size_t size, F &&on_evict) {
+    while (table_size > size) {
+      on_evict(oldest_id());
+      pop();
+    }
+  }
+
+  /**
+   * @return false if the entry is larger than the maximum size and it isn't inserted
+   */
+  template <typename F> bool insert(std::span<const uint8_t> name, std::span<const uint8_t> value, F &&on_evict) {
+    auto hsize = name.size() + value.size() + 32;
+    if (hsize > hpack_max_size) {
+      // RFC 7541 4.4. An entry larger than the maximum size causes the table to be emptied
+      evict(0, on_evict);
+      return false;
+    }
+    evict(hpack_max_size - hsize, on_evict);
+    push(name, value);
+    return true;
+  }
+
+  template <typename F> void update_size(std::size_t size, F &&on_evict) {
+    evict(size, on_evict);
+    reserve(size);
+    hpack_max_size = size;
+  }
+
+private:
+  void push(std::span<const uint8_t> name, std::span<const uint8_t> value);
+  void pop() noexcept;
+  void reserve(std::size_t size);
+
+private:
   std::size_t table_size = 0;
   std::size_t hpack_max_size = 4096;
-  std::deque<record> table;
 
-  using table_iterator = decltype(table.begin());
-  table_iterator shrink_to(std::size_t size);
-  void insert_impl(record &&r);
-  std::size_t record_index(const record *r) const;
+  // Bytes storage. [data_begin, data_end) is a live region in virtual offsets.
+  // A physical offset is 'virtual offset - shift'
+  std::unique_ptr<uint8_t[]> storage;
+  std::size_t storage_size = 0;
+  uint64_t data_begin = 0;
+  uint64_t data_end = 0;
+  uint64_t shift = 0;
+
+  // Entries ring. The capacity is a power of 2
+  std::unique_ptr<entry[]> entries;
+  std::size_t entries_mask = 0;
+  std::size_t count = 0;
+  uint64_t inserted = 0;
 };
 } // namespace rfc7541
@@ -1,26 +1,108 @@
 #include "encoder.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <boost/endian/conversion.hpp>
 
 #include "encoder_stream.h"
 #include "huffman.h"
 #include "integer.h"
-#include "utils/utils.h"
+#include "static_table.h"
 
 using namespace rfc7541;
 
 namespace rfc7541 {
 
-encoder::encoder() : table(config.init_table_size) {}
+encoder::encoder() : encoder(encoder_config{}) {}
+
+encoder::encoder(const encoder_config &conf)
+    : config(conf), table(config.init_table_size), policy(std::make_unique<adaptive_indexing_policy>()) {}
+
+encoder::~encoder() = default;
+
+void encoder::set_indexing_policy(std::unique_ptr<indexing_policy> &&p) {
+  if (p) {
+    policy = std::move(p);
+  }
+}
+
+void encoder::set_table_size_limit(std::size_t limit) {
+  auto size = std::min(limit, config.max_table_size);
+  if (!size_update) {
+    if (size == table.max_size()) {
+      return;
+    }
+    size_update = true;
+    min_table_size = size;
+  }
+  min_table_size = std::min(min_table_size, size);
+  new_table_size = size;
+}
+
+std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(const std::deque<rfc7541::header_field> &fields,
+                                                                  std::size_t size_limit) {
+  std::vector<field_ref> refs;
+  refs.reserve(fields.size());
+  for (const auto &f : fields) {
+    refs.push_back({&f, {}});
+  }
+  return encode(refs, size_limit);
+}
 
-std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc7541::header_field> fields,
+std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::span<const field_ref> fields,
                                                                   std::size_t size_limit) {
   encoder_stream out(size_limit);
+  auto count = encode(fields, out);
+  return {out.flush(), count};
+}
+
+std::size_t encoder::encode(std::span<const field_ref> fields, utils::buffer &out) {
+  encoder_stream stream(out);
+  return encode(fields, stream);
+}
+
+std::size_t encoder::size_hint(std::span<const field_ref> fields) const noexcept {
+  // A representation byte, a name index or a name length and a value length
+  constexpr std::size_t MaxOverhead = 1 + 2 * sizeof(integer::encoded_result::value);
+
+  // Up to two size updates precede fields of a new block. @see write_size_update
+  std::size_t size = size_update && !in_block ? 2 * sizeof(integer::encoded_result::value) : 0;
+  for (const auto &ref : fields) {
+    if (!ref.encoded.empty()) {
+      size += ref.encoded.size();
+    } else {
+      size += ref.field->name().size() + ref.field->value().size() + MaxOverhead;
+    }
+  }
+  return size;
+}
 
+std::size_t encoder::encode(std::span<const field_ref> fields, encoder_stream &out) {
   std::size_t encoded_fields = 0;
-  std::size_t bytes_left = size_limit;
+  std::size_t bytes_left = out.bytes_left();
 
-  for (const auto &f : fields) {
+  bool update_written = false;
+  if (size_update && !in_block) {
+    if (!write_size_update(out, bytes_left)) {
+      return 0;
+    }
+    update_written = true;
+  }
+
+  for (const auto &ref : fields) {
+    if (!ref.encoded.empty()) {
+      // A ready representation
+      if (ref.encoded.size() > bytes_left) {
+        break;
+      }
+      out.push_back(ref.encoded);
+      bytes_left -= ref.encoded.size();
+      ++encoded_fields;
+      continue;
+    }
+
+    const auto &f = *ref.field;
     uint32_t field_size = 0;
 
     // TODO: do not lookup value when it isn't required!
@@ -38,6 +120,9 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
         break;
       }
       out.push_back(encoded_index.as_span());
+      if (std::size_t(index.first) > static_table::size()) {
+        policy->on_hit(f);
+      }
 
       bytes_left -= field_size;
       ++encoded_fields;
@@ -45,16 +130,18 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
       continue;
     }
 
+    // The policy statistics are updated only when the field is written
     command cmd = command::LITERAL_INCREMENTAL_INDEX;
+    literal_decision decision;
     if (f.type() != index_type::DEFAULT) {
       cmd = f.type() == index_type::WITHOUT_INDEX ? command::LITERAL_WITHOUT_INDEX : command::LITERAL_NEVER_INDEX;
+    } else if (decision = policy->decide(f, table.max_size()); !decision.index) {
+      cmd = command::LITERAL_WITHOUT_INDEX;
     }
 
     if (index.first != -1) {
       // Any type of LITERAL where name is already indexed
 
-      // TODO: do not put in the table to huge literals!
-
       // check size by name index & cmd
       auto name_index = integer::encode(cmd, index.first);
       field_size += name_index.length;
@@ -63,7 +150,9 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
       }
 
       // Check size with value string
-      auto value_sz = estimate_string_size(f.value());
+      auto cached = cached_value(f, cmd);
+      auto value_sz = cached ? estimate_string_size(f.value().size(), cached->encoded().size())
+                             : estimate_string_size(f.value());
       field_size += value_sz.first;
       if (field_size > bytes_left) {
         break;
@@ -77,11 +166,16 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
       }
 
       out.push_back(name_index.as_span());
-      out.write_string(value_sz, encoded_value_size, f.value());
+      if (cached && value_sz.second == constants::string_flag::ENCODED) {
+        out.write_encoded(encoded_value_size, cached->encoded());
+      } else {
+        out.write_string(value_sz, encoded_value_size, f.value());
+      }
 
       if (cmd == command::LITERAL_INCREMENTAL_INDEX) {
         table.insert(f.name(), f.value());
       }
+      on_literal(f, decision, {value_sz.second});
 
       bytes_left -= field_size;
       ++encoded_fields;
@@ -90,7 +184,6 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
     }
 
     // And the last situation when name and value aren't indexed
-    // TODO: do not put in the table to huge literals!
 
     auto name_sz = estimate_string_size(f.name());
     field_size += name_sz.first;
@@ -103,7 +196,9 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
       break;
     }
 
-    auto value_sz = estimate_string_size(f.value());
+    auto cached = cached_value(f, cmd);
+    auto value_sz = cached ? estimate_string_size(f.value().size(), cached->encoded().size())
+                           : estimate_string_size(f.value());
     field_size += value_sz.first;
     if (field_size > bytes_left) {
       break;
@@ -117,26 +212,80 @@ std::pair<std::deque<utils::buffer>, std::size_t> encoder::encode(std::deque<rfc
     auto v = cmd_info::get(cmd).value;
     out.push_back({&v, 1});
     out.write_string(name_sz, encoded_name_size, f.name());
-    out.write_string(value_sz, encoded_value_size, f.value());
+    if (cached && value_sz.second == constants::string_flag::ENCODED) {
+      out.write_encoded(encoded_value_size, cached->encoded());
+    } else {
+      out.write_string(value_sz, encoded_value_size, f.value());
+    }
+
+    if (cmd == command::LITERAL_INCREMENTAL_INDEX) {
+      table.insert(f.name(), f.value());
+    }
+    on_literal(f, decision, {name_sz.second, value_sz.second});
 
     bytes_left -= field_size;
     ++encoded_fields;
   }
 
-  return {out.flush(), encoded_fields};
+  // An update that is written without fields is dropped by a caller. It is written again for the next block.
+  // It is safe since the table is already evicted to the minimal size and nothing is inserted since that
+  if (encoded_fields != 0) {
+    size_update = size_update && !update_written;
+    in_block = encoded_fields < fields.size();
+  }
+  return encoded_fields;
+}
+
+bool encoder::write_size_update(encoder_stream &out, std::size_t &bytes_left) {
+  auto min_size = integer::encode(command::CHANGE_TABLE_SIZE, min_table_size);
+  auto new_size = integer::encode(command::CHANGE_TABLE_SIZE, new_table_size);
+  std::size_t size = new_size.length + (min_table_size < new_table_size ? min_size.length : 0);
+  if (size > bytes_left) {
+    return false;
+  }
+
+  if (min_table_size < new_table_size) {
+    // A peer must see the smallest size to evict the same entries
+    out.push_back(min_size.as_span());
+    table.update_size(min_table_size);
+  }
+  out.push_back(new_size.as_span());
+  table.update_size(new_table_size);
+  bytes_left -= size;
+  return true;
 }
 
 std::pair<uint32_t, constants::string_flag> encoder::estimate_string_size(std::span<const uint8_t> src) {
-  auto encoded_bit_len = huffman::estimate_len(src);
+  return estimate_string_size(src.size(), huffman::encoded_size(src));
+}
+
+std::pair<uint32_t, constants::string_flag> encoder::estimate_string_size(std::size_t src_len,
+                                                                          std::size_t encoded_len) {
   // At this point a string size must be less that 2^24-1
-  uint32_t encoded_bytes_len = static_cast<uint32_t>(utils::ceil_order2(encoded_bit_len, 3) / 8);
-  auto src_len = src.size();
-  if (encoded_bytes_len < src_len && (src_len < 10 || (100 * encoded_bytes_len / src_len) <= config.min_huffman_rate)) {
+  if (policy->huffman(src_len, encoded_len)) {
     // Use huffman codes
-    return {encoded_bytes_len, constants::string_flag::ENCODED};
+    return {static_cast<uint32_t>(encoded_len), constants::string_flag::ENCODED};
   }
   // Use as is
-  return {src_len, constants::string_flag::INPLACE};
+  return {static_cast<uint32_t>(src_len), constants::string_flag::INPLACE};
+}
+
+void encoder::on_literal(const header_field &f, const literal_decision &decision,
+                         std::initializer_list<constants::string_flag> strings) {
+  if (f.type() == index_type::DEFAULT) {
+    policy->on_encoded(f, decision);
+  }
+  for (auto flag : strings) {
+    policy->on_string(flag == constants::string_flag::ENCODED);
+  }
+}
+
+huffman_cache::entry_ptr encoder::cached_value(const header_field &f, command cmd) {
+  // Values inserted into the dynamic table are encoded once per session anyway
+  if (!config.string_cache || cmd == command::LITERAL_INCREMENTAL_INDEX) {
+    return nullptr;
+  }
+  return config.string_cache->get(f.value(), f.type() == index_type::NEVER_INDEX);
 }
 
 } // namespace rfc7541
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <deque>
+#include <initializer_list>
+#include <memory>
 #include <span>
 
 #include <utils/buffer.h>
@@ -9,9 +11,13 @@
 #include "constants.h"
 #include "header_field.h"
 #include "hpack_table.h"
+#include "huffman_cache.h"
+#include "indexing_policy.h"
 
 namespace rfc7541 {
 
+class encoder_stream;
+
 class encoder {
 public:
   struct encoder_config {
@@ -22,30 +28,101 @@ public:
     encoder_config &operator=(const encoder_config &) = default;
 
     std::size_t init_table_size = 4096;
-    std::size_t max_table_size = 4096 * 4;
+    std::size_t max_table_size = 4096 * 16;
     std::size_t max_header_list_size = 0; // unlimited by default
-
-    std::size_t min_huffman_rate = 90;        // in percents
-    std::size_t min_dyntable_value_rate = 90; // in percents
+    // An optional cache of Huffman encoded values that are not inserted into the dynamic table.
+    // It can be shared by encoders of all sessions
+    std::shared_ptr<huffman_cache> string_cache;
   };
 
   encoder();
+  /**
+   * @brief encoder creates an encoder with a dynamic table of 'init_table_size' bytes.
+   * @note A peer decoder must be able to use a table of this size.
+   */
+  explicit encoder(const encoder_config &conf);
   encoder(const encoder &) = delete;
   encoder(encoder &&) = default;
-  ~encoder() = default;
+  ~encoder();
 
   void set_config(const encoder_config &conf) { config = conf; }
   const encoder_config &get_config() const { return config; }
 
-  std::pair<std::deque<utils::buffer>, std::size_t> encode(std::deque<rfc7541::header_field> fields,
+  /**
+   * @brief set_table_size_limit applies a peer's SETTINGS_HEADER_TABLE_SIZE.
+   * The dynamic table size becomes min(limit, max_table_size). It grows and shrinks in both directions.
+   * The change is signaled by dynamic table size updates at the start of the next header block.
+   */
+  void set_table_size_limit(std::size_t limit);
+
+  /**
+   * @brief table_size
+   * @return a current maximum size of the dynamic table
+   */
+  std::size_t table_size() const { return table.max_size(); }
+
+  /**
+   * @brief set_indexing_policy replaces the default 'adaptive_indexing_policy'.
+   */
+  void set_indexing_policy(std::unique_ptr<indexing_policy> &&p);
+  const indexing_policy &get_indexing_policy() const { return *policy; }
+
+  /**
+   * @brief The field_ref struct refers to a field that should be encoded.
+   * When 'encoded' isn't empty it is a ready field representation that doesn't depend on the dynamic table.
+   * It is emitted as is.
+   */
+  struct field_ref {
+    const header_field *field = nullptr;
+    std::span<const uint8_t> encoded;
+  };
+
+  /**
+   * @brief encode encodes fields while they fit into 'size_limit' bytes.
+   * A header block is complete when all given fields are encoded.
+   * Otherwise the next call continues the same header block with the rest of fields.
+   * @return encoded data and a count of encoded fields
+   */
+  std::pair<std::deque<utils::buffer>, std::size_t> encode(std::span<const field_ref> fields, std::size_t size_limit);
+  std::pair<std::deque<utils::buffer>, std::size_t> encode(const std::deque<rfc7541::header_field> &fields,
                                                            std::size_t size_limit);
 
+  /**
+   * @brief encode encodes fields into a free space of 'out' while they fit into it.
+   * The data is written contiguously right after committed bytes of 'out'.
+   * So a caller can commit a frame header first and get a ready frame without extra copies.
+   * @return a count of encoded fields
+   */
+  std::size_t encode(std::span<const field_ref> fields, utils::buffer &out);
+
+  /**
+   * @brief size_hint
+   * @return an upper bound of an encoded size of fields including a pending dynamic table size update.
+   * It holds unless an indexing policy chooses Huffman codes that are longer than raw strings.
+   */
+  std::size_t size_hint(std::span<const field_ref> fields) const noexcept;
+
 private:
+  std::size_t encode(std::span<const field_ref> fields, encoder_stream &out);
   std::pair<uint32_t, constants::string_flag> estimate_string_size(std::span<const uint8_t> src);
+  std::pair<uint32_t, constants::string_flag> estimate_string_size(std::size_t src_len, std::size_t encoded_len);
+  huffman_cache::entry_ptr cached_value(const header_field &f, command cmd);
+  // Updates the policy statistics for a written literal and its strings
+  void on_literal(const header_field &f, const literal_decision &decision,
+                  std::initializer_list<constants::string_flag> strings);
+  bool write_size_update(encoder_stream &out, std::size_t &bytes_left);
 
 private:
   encoder_config config;
   encoder_table table;
+  std::unique_ptr<indexing_policy> policy;
+
+  // RFC 7541 4.2. The smallest size and the final size since the last signaled update
+  bool size_update = false;
+  std::size_t min_table_size = 0;
+  std::size_t new_table_size = 0;
+  // The last header block isn't complete. Size updates aren't allowed until it ends
+  bool in_block = false;
 };
 
 } // namespace rfc7541
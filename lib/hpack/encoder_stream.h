@@ -6,9 +6,17 @@
 
 namespace rfc7541 {
 
+/**
+ * @brief The encoder_stream class is an output of encoded fields.
+ * By default it collects data in a chain of buffers.
+ * When it is created for a given buffer it writes data right after committed bytes of the buffer.
+ * So a data is contiguous and a caller can reserve a room in front of it.
+ */
 class encoder_stream {
 public:
   explicit encoder_stream(std::size_t max) : max_size(max), left(max) {}
+  explicit encoder_stream(utils::buffer &dst)
+      : target(&dst), max_size(dst.prepare().size_bytes()), left(max_size) {}
   encoder_stream(const encoder_stream &) = delete;
   encoder_stream &operator=(const encoder_stream &) = delete;
   encoder_stream(encoder_stream &&) = delete;
@@ -19,6 +27,10 @@ public:
 
   void write_string(std::pair<std::size_t, constants::string_flag> estimation, integer::encoded_result encoded_size,
                     std::span<const uint8_t> src);
+  /**
+   * @brief write_encoded writes a string that is already Huffman encoded.
+   */
+  void write_encoded(integer::encoded_result encoded_size, std::span<const uint8_t> encoded);
 
   auto flush() {
     left = max_size;
@@ -27,9 +39,17 @@ public:
   std::size_t bytes_left() const noexcept { return left; }
 
 private:
-  void encode_string(const std::span<const uint8_t> src);
+  void put(std::span<const uint8_t> src) {
+    if (target) {
+      target->commit(src);
+    } else {
+      stream.push_back(src);
+    }
+  }
+  void encode_string(const std::span<const uint8_t> src, std::size_t size);
 
 private:
+  utils::buffer *target = nullptr;
   utils::streambuf stream;
   std::size_t max_size;
   std::size_t left;
@@ -1,7 +1,10 @@
 #include "header_field.h"
 
+#include <algorithm>
 #include <stdexcept>
 
+#include "huffman.h"
+
 namespace {
 
 template <typename T, typename V> void check_max_size(T t, V v) {
@@ -33,6 +36,25 @@ header_field::header_field(std::vector<uint8_t> &&name, std::vector<uint8_t> &&v
   m_value = std::move(value);
 }
 
+header_field::header_field(const header_field_view &view) : header_field(view.name(), view.value(), view.type()) {
+  m_huffman = view.is_huffman();
+  m_atom = view.name_atom();
+}
+
+void header_field::decode_value() const {
+  // A value has been validated by the decoder
+  std::vector<uint8_t> decoded(huffman::max_decoded_size(m_value.size()));
+  huffman::decode_state state;
+  auto *last = huffman::decode(m_value, decoded.data(), state);
+  decoded.resize(last - decoded.data());
+
+  if (m_type == index_type::NEVER_INDEX) {
+    std::fill(m_value.begin(), m_value.end(), 0);
+  }
+  m_value = std::move(decoded);
+  m_huffman = false;
+}
+
 header_field::~header_field() {
   if (m_type == index_type::NEVER_INDEX) {
     std::fill(m_name.begin(), m_name.end(), 0);
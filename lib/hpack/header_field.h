@@ -5,6 +5,8 @@
 #include <string_view>
 #include <vector>
 
+#include "atom.h"
+
 namespace rfc7541 {
 
 enum class index_type : unsigned {
@@ -31,12 +33,17 @@ enum class index_type : unsigned {
  * WITHOUT_INDEX but in the case when a peer want to send it back it must not use indexing for this value. This type is
  * reuquired by security sensual data. So a value with this flag will never be stored in encoder/decoder tables.
  *
+ * A value received from a peer can be kept Huffman encoded. It is decoded by the first 'value' or 'value_view' call.
+ * So the first access modifies the field and isn't thread safe.
+ *
  * @note: RFC7540 (HTTP/1.1) describes generic HTTP filed name/value
  * limitations. RFC7540 (HTTP2) has also him own not so strict  limitaions for
  * that. But RFC7541 (HPACK) doesn't have anything relevant. So this
  * implementation doesn't have any restriction for name/value content.
  * Such restrictions should be implemented later on the layer up.
  */
+class header_field_view;
+
 class header_field {
 public:
   header_field(const header_field &) = default;
@@ -50,30 +57,100 @@ public:
   header_field(std::string_view name, std::string_view value, index_type type = index_type::DEFAULT);
   header_field(std::vector<uint8_t> &&name, std::vector<uint8_t> &&value, index_type type = index_type::DEFAULT);
 
+  /**
+   * @brief header_field materializes a given view. I. e. copies name and value into own storage.
+   * A Huffman encoded value is copied as is.
+   */
+  explicit header_field(const header_field_view &view);
+
   [[nodiscard]] index_type type() const noexcept { return m_type; }
 
   [[nodiscard]] std::span<const uint8_t> name() const noexcept { return m_name; }
-  [[nodiscard]] std::span<const uint8_t> value() const noexcept { return m_value; }
+  [[nodiscard]] std::span<const uint8_t> value() const {
+    if (m_huffman) {
+      decode_value();
+    }
+    return m_value;
+  }
 
   [[nodiscard]] std::string_view name_view() const noexcept {
     return {reinterpret_cast<const char *>(m_name.data()), m_name.size()};
   }
   [[nodiscard]] std::string_view value_view() const {
-    return {reinterpret_cast<const char *>(m_value.data()), m_value.size()};
+    auto v = value();
+    return {reinterpret_cast<const char *>(v.data()), v.size()};
   }
 
+  /**
+   * @brief is_huffman
+   * @return true while a value is kept Huffman encoded
+   */
+  [[nodiscard]] bool is_huffman() const noexcept { return m_huffman; }
+
+  /**
+   * @brief name_atom
+   * @return an atom of the name that is set by the decoder. Fields that are created by a user have no atom
+   */
+  [[nodiscard]] atom name_atom() const noexcept { return m_atom; }
+
   /**
    * @brief hpack_size returns a HPACK specific size.
    * Should be used from encoder/decoder internals.
    */
-  [[nodiscard]] auto hpack_size() const noexcept { return m_name.size() + m_value.size() + 32; }
+  [[nodiscard]] auto hpack_size() const { return m_name.size() + value().size() + 32; }
 
 protected:
   std::vector<uint8_t> m_name;
-  std::vector<uint8_t> m_value;
+  mutable std::vector<uint8_t> m_value;
   index_type m_type = index_type::DEFAULT;
+  mutable bool m_huffman = false;
+  atom m_atom = atoms::none;
+
+private:
+  void decode_value() const;
 };
 
 using header = std::vector<header_field>;
 
+/**
+ * @brief The header_field_view class is a non-owning representation of a decoded header field.
+ * Name and value point into the static table, into the raw header block that has been decoded
+ * or into decoder owned storage (Huffman decoded strings and dynamic table entries).
+ * So a view is valid only while the raw header block is alive and until the next decoding call.
+ * Use 'header_field(const header_field_view &)' when a field should be kept longer.
+ * When 'is_huffman' is true the value is a validated Huffman encoded string (@see field_sink::accepts_huffman).
+ */
+class header_field_view {
+public:
+  header_field_view(std::span<const uint8_t> name, std::span<const uint8_t> value,
+                    index_type type = index_type::DEFAULT, bool is_huffman = false,
+                    atom name_atom = atoms::none) noexcept
+      : m_name(name), m_value(value), m_type(type), m_huffman(is_huffman), m_atom(name_atom) {}
+
+  [[nodiscard]] index_type type() const noexcept { return m_type; }
+  [[nodiscard]] bool is_huffman() const noexcept { return m_huffman; }
+  [[nodiscard]] atom name_atom() const noexcept { return m_atom; }
+
+  [[nodiscard]] std::span<const uint8_t> name() const noexcept { return m_name; }
+  [[nodiscard]] std::span<const uint8_t> value() const noexcept { return m_value; }
+
+  [[nodiscard]] std::string_view name_view() const noexcept {
+    return {reinterpret_cast<const char *>(m_name.data()), m_name.size()};
+  }
+  [[nodiscard]] std::string_view value_view() const noexcept {
+    return {reinterpret_cast<const char *>(m_value.data()), m_value.size()};
+  }
+
+  [[nodiscard]] auto hpack_size() const noexcept { return m_name.size() + m_value.size() + 32; }
+
+private:
+  std::span<const uint8_t> m_name;
+  std::span<const uint8_t> m_value;
+  index_type m_type = index_type::DEFAULT;
+  bool m_huffman = false;
+  atom m_atom = atoms::none;
+};
+
+using header_view = std::vector<header_field_view>;
+
 } // namespace rfc7541
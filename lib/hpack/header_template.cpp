@@ -0,0 +1,78 @@
+#include "header_template.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "constants.h"
+#include "encoder_stream.h"
+#include "huffman.h"
+#include "integer.h"
+#include "static_table.h"
+
+namespace rfc7541 {
+
+namespace {
+void write_string(encoder_stream &out, std::span<const uint8_t> src) {
+  auto huffman_size = huffman::encoded_size(src);
+  std::pair<std::size_t, constants::string_flag> estimation{src.size(), constants::string_flag::INPLACE};
+  if (huffman_size < src.size()) {
+    estimation = {huffman_size, constants::string_flag::ENCODED};
+  }
+  out.write_string(estimation, integer::encode(estimation.second, estimation.first), src);
+}
+
+// Encodes a field with no dynamic table. Returns an empty vector when a field should be indexed
+std::vector<uint8_t> encode_static(const header_field &field) {
+  auto [index, has_value] = static_table::field_index(field.name(), field.value());
+  if (field.type() == index_type::DEFAULT) {
+    if (index == -1 || !has_value) {
+      return {};
+    }
+    auto encoded = integer::encode(command::INDEX, index);
+    return {encoded.value, encoded.value + encoded.length};
+  }
+
+  auto cmd =
+      field.type() == index_type::WITHOUT_INDEX ? command::LITERAL_WITHOUT_INDEX : command::LITERAL_NEVER_INDEX;
+  encoder_stream out(std::numeric_limits<std::size_t>::max());
+  if (index != -1) {
+    out.push_back(integer::encode(cmd, index).as_span());
+  } else {
+    auto v = cmd_info::get(cmd).value;
+    out.push_back({&v, 1});
+    write_string(out, field.name());
+  }
+  write_string(out, field.value());
+
+  std::vector<uint8_t> result;
+  for (const auto &b : out.flush()) {
+    result.insert(result.end(), b.data_view().begin(), b.data_view().end());
+  }
+  return result;
+}
+} // namespace
+
+header_template::header_template(std::initializer_list<header_field> fields) {
+  for (const auto &f : fields) {
+    add(header_field(f));
+  }
+}
+
+header_template::~header_template() = default;
+
+const header_template::entry *header_template::find(std::string_view name) const noexcept {
+  auto it = std::find_if(entries.begin(), entries.end(), [name](const auto &e) { return e.field.name_view() == name; });
+  return it == entries.end() ? nullptr : &*it;
+}
+
+void header_template::add(header_field &&field) {
+  auto encoded = encode_static(field);
+  if (field.name_view().starts_with(':')) {
+    entries.insert(entries.begin() + pseudo_count, entry{std::move(field), std::move(encoded)});
+    ++pseudo_count;
+  } else {
+    entries.push_back(entry{std::move(field), std::move(encoded)});
+  }
+}
+
+} // namespace rfc7541
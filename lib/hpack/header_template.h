@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "header_field.h"
+
+namespace rfc7541 {
+
+/**
+ * @brief The header_template class is a set of header fields shared by many requests.
+ * Fields those don't need the dynamic table are encoded once at construction:
+ * - a field that is fully present in the static table is encoded as an index;
+ * - a field with 'index_type::WITHOUT_INDEX' or 'index_type::NEVER_INDEX' is encoded as a literal
+ *   with a static name index when it is possible.
+ * Other fields are encoded by an encoder as usual since they are worth to be kept in the dynamic table.
+ * Pseudo-headers are placed before regular headers.
+ */
+class header_template {
+public:
+  struct entry {
+    header_field field;
+    // A ready field representation. It is empty when a field needs the dynamic table
+    std::vector<uint8_t> encoded;
+  };
+
+  header_template(std::initializer_list<header_field> fields);
+  template <typename II> header_template(II begin, II end) {
+    while (begin != end) {
+      add(header_field(*begin++));
+    }
+  }
+  header_template(const header_template &) = delete;
+  header_template &operator=(const header_template &) = delete;
+  header_template(header_template &&) = default;
+  header_template &operator=(header_template &&) = default;
+  ~header_template();
+
+  [[nodiscard]] std::span<const entry> pseudo_headers() const noexcept { return {entries.data(), pseudo_count}; }
+  [[nodiscard]] std::span<const entry> regular_headers() const noexcept {
+    return std::span<const entry>(entries).subspan(pseudo_count);
+  }
+  [[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+
+  /**
+   * @brief find
+   * @return a first entry with a given name or nullptr
+   */
+  [[nodiscard]] const entry *find(std::string_view name) const noexcept;
+
+private:
+  void add(header_field &&field);
+
+private:
+  std::vector<entry> entries;
+  std::size_t pseudo_count = 0;
+};
+
+} // namespace rfc7541
@@ -45,6 +45,8 @@ public:
       return std::make_pair(dyn_i + static_table::size(), dyn_has_value);
     } else if (i != -1) {
       return std::make_pair(i, has_value);
+    } else if (dyn_i != -1) {
+      return std::make_pair(dyn_i + static_table::size(), dyn_has_value);
     }
     return std::make_pair(dyn_i, dyn_has_value);
   }
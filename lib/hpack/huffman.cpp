@@ -1,13 +1,25 @@
 #include "huffman.h"
 
-#include <numeric>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/endian/conversion.hpp>
+
+#include "utils/utils.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HUFFMAN_AVX2 1
+#include <immintrin.h>
+#endif
 
 namespace {
 
 #pragma pack(push)
 #pragma pack(4)
 // Static Huffman table by RFC7541. The byte value is an array index
-static const rfc7541::huffman::huffman_code huffman_table[]{
+static constexpr rfc7541::huffman::huffman_code huffman_table[]{
     {0xffc00000ul, 13}, //      11111111|11000
     {0xffffb000ul, 23}, //      11111111|11111111|1011000
     {0xfffffe20ul, 28}, //      11111111|11111111|11111110|0010
@@ -314,6 +326,193 @@ short int find(const uint32_t code) {
   return -1;
 }
 
+/**
+ * @brief The decode_table class is a finite state machine for huffman strings decoding.
+ * A state is an internal node of the huffman tree. A transition consumes 8 bits of input,
+ * so the table has 256 states x 256 inputs. Every entry contains a next state, up to 2 decoded symbols
+ * and flags. EOS and padding validation are folded into flags as well.
+ */
+class decode_table {
+public:
+  static constexpr uint8_t SYMBOLS_MASK = 0x03;
+  static constexpr uint8_t ACCEPTED = 0x04;
+  static constexpr uint8_t FAILED = 0x08;
+
+  struct entry {
+    uint8_t state;
+    uint8_t flags;
+    uint8_t symbols[2];
+  };
+
+  decode_table();
+
+  const entry &at(uint8_t state, uint8_t byte) const noexcept { return entries[(std::size_t(state) << 8) | byte]; }
+
+private:
+  static constexpr std::size_t STATES = 256;
+
+  std::vector<entry> entries;
+};
+
+decode_table::decode_table() : entries(STATES * 256) {
+  // Build the huffman tree. Every internal node has two children.
+  // A child >= 0 is an index of internal node, a child < 0 is a leaf with symbol '-child - 1'
+  struct node {
+    int16_t child[2] = {0, 0};
+  };
+  std::vector<node> tree(1);
+
+  for (uint16_t symbol = 0; symbol <= rfc7541::huffman::EOS; ++symbol) {
+    const auto &code = huffman_table[symbol];
+    std::size_t current = 0;
+    for (unsigned i = 0; i < code.bitLength; ++i) {
+      auto bit = (code.huffmanCode >> (31 - i)) & 1;
+      if (i + 1 == code.bitLength) {
+        tree[current].child[bit] = static_cast<int16_t>(-symbol - 1);
+      } else {
+        if (tree[current].child[bit] == 0) {
+          tree[current].child[bit] = static_cast<int16_t>(tree.size());
+          tree.emplace_back();
+        }
+        current = tree[current].child[bit];
+      }
+    }
+  }
+
+  if (tree.size() != STATES) {
+    throw std::logic_error("Invalid huffman tree");
+  }
+
+  // A string can be finished only in the nodes those are reachable from the root by less than 8 '1' bits
+  std::array<bool, STATES> accepted{};
+  std::size_t current = 0;
+  for (unsigned depth = 0; depth < 8; ++depth) {
+    accepted[current] = true;
+    current = tree[current].child[1];
+  }
+
+  for (std::size_t state = 0; state < STATES; ++state) {
+    for (unsigned byte = 0; byte < 256; ++byte) {
+      auto &e = entries[(state << 8) | byte];
+      std::size_t current = state;
+      uint8_t flags = 0;
+      for (int i = 7; i >= 0; --i) {
+        auto child = tree[current].child[(byte >> i) & 1];
+        if (child >= 0) {
+          current = child;
+          continue;
+        }
+        auto symbol = -child - 1;
+        if (symbol == rfc7541::huffman::EOS) {
+          flags |= FAILED;
+          break;
+        }
+        if ((flags & SYMBOLS_MASK) == std::size(e.symbols)) {
+          throw std::logic_error("Too many symbols per byte");
+        }
+        e.symbols[flags & SYMBOLS_MASK] = static_cast<uint8_t>(symbol);
+        ++flags;
+        current = 0;
+      }
+      e.state = static_cast<uint8_t>(current);
+      e.flags = accepted[current] ? flags | ACCEPTED : flags;
+    }
+  }
+}
+
+const decode_table &get_decode_table() {
+  static const decode_table table;
+  return table;
+}
+
+// Codes of bytes aligned to the right. So a symbol is appended by a single shift
+struct packed_code {
+  uint32_t code;
+  uint32_t length;
+};
+
+constexpr auto packed_codes = [] {
+  std::array<packed_code, 256> codes{};
+  for (std::size_t i = 0; i < codes.size(); ++i) {
+    codes[i] = {huffman_table[i].huffmanCode >> (32 - huffman_table[i].bitLength), huffman_table[i].bitLength};
+  }
+  return codes;
+}();
+
+constexpr auto code_lengths = [] {
+  std::array<uint8_t, 256> lengths{};
+  for (std::size_t i = 0; i < lengths.size(); ++i) {
+    lengths[i] = huffman_table[i].bitLength;
+  }
+  return lengths;
+}();
+
+std::size_t estimate_len_scalar(const uint8_t *data, std::size_t size) {
+  // Independent sums don't wait for each other
+  std::size_t bits[4] = {0, 0, 0, 0};
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    bits[0] += code_lengths[data[i]];
+    bits[1] += code_lengths[data[i + 1]];
+    bits[2] += code_lengths[data[i + 2]];
+    bits[3] += code_lengths[data[i + 3]];
+  }
+  for (; i < size; ++i) {
+    bits[0] += code_lengths[data[i]];
+  }
+  return bits[0] + bits[1] + bits[2] + bits[3];
+}
+
+#ifdef HUFFMAN_AVX2
+// Printable ASCII (0x20..0x7f) is looked up by 6 shuffles of 16 code lengths, one per a high nibble.
+// Blocks with other bytes are rare in header fields and use the scalar code.
+__attribute__((target("avx2"))) std::size_t estimate_len_avx2(const uint8_t *data, std::size_t size) {
+  constexpr uint8_t FirstNibble = 2;
+  constexpr std::size_t Nibbles = 6;
+
+  __m256i lengths[Nibbles];
+  for (std::size_t i = 0; i < Nibbles; ++i) {
+    const auto *row = reinterpret_cast<const __m128i *>(code_lengths.data() + (FirstNibble + i) * 16);
+    lengths[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128(row));
+  }
+  const auto low_mask = _mm256_set1_epi8(0x0f);
+  const auto first_nibble = _mm256_set1_epi8(FirstNibble);
+  const auto zero = _mm256_setzero_si256();
+
+  auto sums = zero;
+  std::size_t bits = 0;
+  std::size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    auto hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    // A sign bit is set for bytes >= 0x80 and for bytes < 0x20
+    if (_mm256_movemask_epi8(_mm256_or_si256(v, _mm256_cmpgt_epi8(first_nibble, hi))) != 0) {
+      bits += estimate_len_scalar(data + i, 32);
+      continue;
+    }
+
+    auto lo = _mm256_and_si256(v, low_mask);
+    auto len = zero;
+    for (std::size_t n = 0; n < Nibbles; ++n) {
+      auto match = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(static_cast<char>(FirstNibble + n)));
+      len = _mm256_or_si256(len, _mm256_and_si256(match, _mm256_shuffle_epi8(lengths[n], lo)));
+    }
+    sums = _mm256_add_epi64(sums, _mm256_sad_epu8(len, zero));
+  }
+
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sums);
+  return bits + lanes[0] + lanes[1] + lanes[2] + lanes[3] + estimate_len_scalar(data + i, size - i);
+}
+
+using estimate_ptr = decltype(&estimate_len_scalar);
+
+estimate_ptr select_estimate_len() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? &estimate_len_avx2 : &estimate_len_scalar;
+}
+#endif
+
 } // namespace
 
 namespace rfc7541 {
@@ -332,10 +531,90 @@ const huffman_code &encode(uint16_t value) { return huffman_table[value]; }
 
 const std::span<const uint8_t> allowed_code_lengths() { return code_len_array; }
 
+uint8_t *decode(std::span<const uint8_t> src, uint8_t *out, decode_state &state) {
+  const auto &table = get_decode_table();
+
+  auto current = state.node;
+  uint8_t flags = state.accepted ? decode_table::ACCEPTED : 0;
+  for (auto byte : src) {
+    const auto &e = table.at(current, byte);
+    // Both symbols are written every time. The output has a room for that
+    out[0] = e.symbols[0];
+    out[1] = e.symbols[1];
+    out += e.flags & decode_table::SYMBOLS_MASK;
+    current = e.state;
+    flags = e.flags;
+    if (flags & decode_table::FAILED) {
+      throw std::invalid_argument("Can't decode huffman code");
+    }
+  }
+
+  state.node = current;
+  state.accepted = flags & decode_table::ACCEPTED;
+  return out;
+}
+
+bool validate(std::span<const uint8_t> src) noexcept {
+  const auto &table = get_decode_table();
+
+  uint8_t current = 0;
+  uint8_t flags = decode_table::ACCEPTED;
+  for (auto byte : src) {
+    const auto &e = table.at(current, byte);
+    current = e.state;
+    flags = e.flags;
+    if (flags & decode_table::FAILED) {
+      return false;
+    }
+  }
+  return flags & decode_table::ACCEPTED;
+}
+
 std::size_t estimate_len(std::span<const uint8_t> data) {
-  auto bits = std::accumulate(std::begin(data), std::end(data), static_cast<std::size_t>(0),
-                              [](auto sum, auto byte) { return sum + encode(byte).bitLength; });
-  return bits;
+#ifdef HUFFMAN_AVX2
+  if (data.size() >= 32) {
+    static const estimate_ptr impl = select_estimate_len();
+    return impl(data.data(), data.size());
+  }
+#endif
+  return estimate_len_scalar(data.data(), data.size());
+}
+
+uint8_t *encode(std::span<const uint8_t> src, std::span<uint8_t> out) {
+  auto *dst = out.data();
+  auto *const end = out.data() + out.size();
+
+  // Pending bits are aligned to the right. Codes are not longer than 30 bits,
+  // so a word is flushed before it overflows and keeps less than 8 bits after that
+  uint64_t bits = 0;
+  unsigned len = 0;
+  auto flush = [&] {
+    auto word = boost::endian::native_to_big(bits << (64 - len));
+    auto ready = len / 8;
+    // A whole word is written while it fits. Extra bytes are overwritten by the next flush
+    memcpy(dst, &word, end - dst >= 8 ? 8 : ready);
+    dst += ready;
+    len -= ready * 8;
+  };
+
+  for (auto byte : src) {
+    const auto &code = packed_codes[byte];
+    if (len + code.length > 64) {
+      flush();
+    }
+    bits = (bits << code.length) | code.code;
+    len += code.length;
+  }
+
+  if (len >= 8) {
+    flush();
+  }
+  if (len > 0) {
+    // The tail is padded by the most significant bits of EOS
+    auto padding = 8 - len;
+    *dst++ = static_cast<uint8_t>((bits << padding) | utils::make_mask<uint64_t>(padding));
+  }
+  return dst;
 }
 
 } // namespace huffman
@@ -20,11 +20,64 @@ std::optional<value_type> decode(const huffman_code &code);
 const huffman_code &encode(value_type value);
 const std::span<const uint8_t> allowed_code_lengths();
 
+/**
+ * @brief The decode_state struct keeps a state of the table driven string decoder
+ * between 'decode' calls. So a string can be decoded by pieces.
+ * 'node' is a position inside the huffman tree, 'accepted' is true when all bits consumed after the last symbol
+ * are a valid EOS padding, i.e. the string can be finished here.
+ */
+struct decode_state {
+  uint8_t node = 0;
+  bool accepted = true;
+};
+
+/**
+ * @brief max_decoded_size
+ * @param encoded_size is a size of huffman encoded data in bytes
+ * @return a size of the output buffer that is enough for 'decode'.
+ * The shortest code is 5 bits long and the decoder can write one extra byte after the last symbol.
+ */
+constexpr std::size_t max_decoded_size(std::size_t encoded_size) { return encoded_size * 8 / 5 + 2; }
+
+/**
+ * @brief decode decodes a huffman encoded data byte by byte. Every step consumes 8 bits of input
+ * and emits up to 2 symbols.
+ * @param src is an encoded data
+ * @param out is an output buffer. Must have at least 'max_decoded_size(src.size())' bytes
+ * @param state is a decoder state. Use a default constructed one for a new string.
+ * @note throws std::invalid_argument when the data contains the EOS symbol or an invalid code.
+ * A caller should check 'state.accepted' after the last piece of the string.
+ * @return a pointer past the last decoded symbol
+ */
+uint8_t *decode(std::span<const uint8_t> src, uint8_t *out, decode_state &state);
+
+/**
+ * @brief validate checks a huffman encoded string with no decoding.
+ * @return false when the data contains the EOS symbol or an invalid padding
+ */
+bool validate(std::span<const uint8_t> src) noexcept;
+
 /**
  * @brief estimate_len
  * @param data
  * @return encoded data length in bits
+ * @note Uses AVX2 when a CPU supports it.
  */
 std::size_t estimate_len(std::span<const uint8_t> data);
 
+/**
+ * @brief encoded_size
+ * @return a size of huffman encoded data in bytes including the EOS padding
+ */
+inline std::size_t encoded_size(std::span<const uint8_t> data) { return (estimate_len(data) + 7) / 8; }
+
+/**
+ * @brief encode encodes a string and pads the last byte by EOS bits.
+ * Encoded data is written by 64 bit words while they fit into 'out'.
+ * @param src is a string for encoding
+ * @param out is an output buffer. Must have at least 'encoded_size(src)' bytes
+ * @return a pointer past the last encoded byte
+ */
+uint8_t *encode(std::span<const uint8_t> src, std::span<uint8_t> out);
+
 } // namespace rfc7541::huffman
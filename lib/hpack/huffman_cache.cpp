@@ -0,0 +1,119 @@
+#include "huffman_cache.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+#include "huffman.h"
+
+namespace rfc7541 {
+
+namespace {
+std::string_view as_string_view(std::span<const uint8_t> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+
+// Stores through a volatile pointer are not removed as dead ones before the memory is freed
+void wipe(std::vector<uint8_t> &data) noexcept {
+  volatile uint8_t *p = data.data();
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    p[i] = 0;
+  }
+}
+} // namespace
+
+huffman_cache::entry::entry(std::span<const uint8_t> value, bool sensitive)
+    : m_value(value.begin(), value.end()), m_encoded(huffman::encoded_size(value)), m_sensitive(sensitive) {
+  huffman::encode(m_value, m_encoded);
+}
+
+huffman_cache::entry::~entry() {
+  if (is_sensitive()) {
+    wipe(m_value);
+    wipe(m_encoded);
+  }
+}
+
+huffman_cache::entry_ptr huffman_cache::mark(const std::shared_ptr<entry> &e, bool sensitive) noexcept {
+  e->m_used.store(true, std::memory_order_relaxed);
+  if (sensitive) {
+    e->m_sensitive.store(true, std::memory_order_relaxed);
+  }
+  return e;
+}
+
+huffman_cache::huffman_cache(std::size_t max_bytes, std::size_t min_size)
+    : shard_limit(max_bytes / ShardsCount), min_string_size(std::max<std::size_t>(min_size, 1)) {}
+
+huffman_cache::~huffman_cache() = default;
+
+huffman_cache::entry_ptr huffman_cache::get(std::span<const uint8_t> value, bool sensitive) {
+  if (value.size() < min_string_size) {
+    return nullptr;
+  }
+
+  auto key = as_string_view(value);
+  auto &s = shards[std::hash<std::string_view>{}(key) % ShardsCount];
+  {
+    // Concurrent hits don't block each other
+    std::shared_lock lock(s.mutex);
+    if (auto it = s.index.find(key); it != s.index.end()) {
+      return mark(*it->second, sensitive);
+    }
+  }
+
+  // Encode without the lock. Other threads can encode the same string at the same time. The first one is kept
+  auto e = std::make_shared<entry>(value, sensitive);
+  if (e->cost() > shard_limit) {
+    return e;
+  }
+
+  std::unique_lock lock(s.mutex);
+  if (auto it = s.index.find(key); it != s.index.end()) {
+    return mark(*it->second, sensitive);
+  }
+  while (!s.lru.empty() && s.size + e->cost() > shard_limit) {
+    const auto &oldest = s.lru.back();
+    if (oldest->m_used.exchange(false, std::memory_order_relaxed)) {
+      // An entry that is used since it was checked last time gets a second chance
+      s.lru.splice(s.lru.begin(), s.lru, std::prev(s.lru.end()));
+      continue;
+    }
+    s.size -= oldest->cost();
+    s.index.erase(as_string_view(oldest->value()));
+    s.lru.pop_back();
+  }
+  s.lru.push_front(e);
+  s.index.emplace(as_string_view(e->value()), s.lru.begin());
+  s.size += e->cost();
+  return e;
+}
+
+std::size_t huffman_cache::size() const {
+  std::size_t result = 0;
+  for (const auto &s : shards) {
+    std::shared_lock lock(s.mutex);
+    result += s.size;
+  }
+  return result;
+}
+
+std::size_t huffman_cache::count() const {
+  std::size_t result = 0;
+  for (const auto &s : shards) {
+    std::shared_lock lock(s.mutex);
+    result += s.lru.size();
+  }
+  return result;
+}
+
+void huffman_cache::clear() {
+  for (auto &s : shards) {
+    std::unique_lock lock(s.mutex);
+    s.index.clear();
+    s.lru.clear();
+    s.size = 0;
+  }
+}
+
+} // namespace rfc7541
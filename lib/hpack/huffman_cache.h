@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rfc7541 {
+
+/**
+ * @brief The huffman_cache class keeps Huffman encoded forms of recently used strings.
+ * It is shared by encoders of many sessions to encode long values that are not indexed
+ * (e.g. authorization tokens) once per process instead of once per request.
+ * The cache is split into shards by a string hash. Every shard has its own read-write lock and its own list.
+ * Hits take the lock in a shared mode and only mark an entry as used. Entries are evicted by the second chance
+ * (CLOCK) algorithm: a used entry is moved to the list front once instead of being evicted.
+ * Its size is bounded by 'max_bytes' for strings and their encoded forms together.
+ * Entries of sensitive strings (NEVER_INDEX fields) are wiped when they are destroyed.
+ */
+class huffman_cache {
+public:
+  class entry {
+  public:
+    entry(std::span<const uint8_t> value, bool sensitive);
+    entry(const entry &) = delete;
+    entry &operator=(const entry &) = delete;
+    ~entry();
+
+    std::span<const uint8_t> value() const noexcept { return m_value; }
+    std::span<const uint8_t> encoded() const noexcept { return m_encoded; }
+    bool is_sensitive() const noexcept { return m_sensitive.load(std::memory_order_relaxed); }
+
+    std::size_t cost() const noexcept { return m_value.size() + m_encoded.size() + sizeof(entry); }
+
+  private:
+    std::vector<uint8_t> m_value;
+    std::vector<uint8_t> m_encoded;
+    // Are set by the cache while other threads use the entry
+    std::atomic<bool> m_sensitive;
+    std::atomic<bool> m_used = false;
+
+    friend huffman_cache;
+  };
+  using entry_ptr = std::shared_ptr<const entry>;
+
+  /**
+   * @param max_bytes is a total size limit
+   * @param min_size is a minimal size of a string that is worth caching
+   */
+  explicit huffman_cache(std::size_t max_bytes, std::size_t min_size = 64);
+  huffman_cache(const huffman_cache &) = delete;
+  huffman_cache &operator=(const huffman_cache &) = delete;
+  huffman_cache(huffman_cache &&) = delete;
+  huffman_cache &operator=(huffman_cache &&) = delete;
+  ~huffman_cache();
+
+  /**
+   * @brief get finds an encoded string or encodes it and inserts into the cache.
+   * An entry is kept alive by the returned pointer even if it's evicted by another thread.
+   * @param sensitive marks the string to be wiped from memory with the entry
+   * @return nullptr when a string is shorter than 'min_size'
+   */
+  entry_ptr get(std::span<const uint8_t> value, bool sensitive = false);
+
+  std::size_t min_size() const noexcept { return min_string_size; }
+
+  /**
+   * @brief size
+   * @return a current size of all entries in bytes
+   */
+  std::size_t size() const;
+  std::size_t count() const;
+  void clear();
+
+private:
+  static constexpr std::size_t ShardsCount = 8;
+
+  // Marks a found entry as used. It is called under a shared lock, so only atomic flags are changed
+  static entry_ptr mark(const std::shared_ptr<entry> &e, bool sensitive) noexcept;
+
+  struct shard {
+    mutable std::shared_mutex mutex;
+    // New entries are at the front. Eviction starts from the back. Map keys point into entries
+    std::list<std::shared_ptr<entry>> lru;
+    std::unordered_map<std::string_view, std::list<std::shared_ptr<entry>>::iterator> index;
+    std::size_t size = 0;
+  };
+
+  std::size_t shard_limit;
+  std::size_t min_string_size;
+  std::array<shard, ShardsCount> shards;
+};
+
+} // namespace rfc7541
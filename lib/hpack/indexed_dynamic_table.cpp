@@ -1,76 +1,146 @@
 #include "indexed_dynamic_table.h"
 
 #include <algorithm>
-#include <compare>
-#include <cstring>
-#include <tuple>
-
-namespace std {
-std::strong_ordering operator<=>(const std::span<const uint8_t> lhs, const std::span<const uint8_t> rhs) {
-  auto size_cmp = lhs.size_bytes() <=> rhs.size_bytes();
-  if (size_cmp != std::strong_ordering::equal) {
-    return size_cmp;
+#include <string_view>
+
+namespace rfc7541 {
+
+namespace {
+std::size_t hash_bytes(std::span<const uint8_t> data) {
+  return std::hash<std::string_view>{}({reinterpret_cast<const char *>(data.data()), data.size()});
+}
+
+std::size_t hash_field(std::size_t name_hash, std::span<const uint8_t> value) {
+  return name_hash ^ (hash_bytes(value) + 0x9e3779b97f4a7c15ull + (name_hash << 6) + (name_hash >> 2));
+}
+
+bool equal(std::span<const uint8_t> lhs, std::span<const uint8_t> rhs) {
+  return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+} // namespace
+
+void indexed_dynamic_table::hash_index::reset(std::size_t capacity) {
+  slots.reset(new slot[capacity]);
+  mask = capacity - 1;
+}
+
+template <typename Eq> uint64_t indexed_dynamic_table::hash_index::find(std::size_t hash, Eq &&eq) const {
+  for (auto i = hash & mask; slots[i].id != NoEntry; i = (i + 1) & mask) {
+    if (slots[i].hash == hash && eq(slots[i].id)) {
+      return slots[i].id;
+    }
   }
+  return NoEntry;
+}
 
-  auto data_cmp = memcmp(lhs.data(), rhs.data(), rhs.size_bytes());
-  if (data_cmp == 0) {
-    return std::strong_ordering::equal;
-  } else if (data_cmp < 0) {
-    return std::strong_ordering::less;
+template <typename Eq> void indexed_dynamic_table::hash_index::insert(uint64_t id, std::size_t hash, Eq &&eq) {
+  auto i = hash & mask;
+  for (; slots[i].id != NoEntry; i = (i + 1) & mask) {
+    if (slots[i].hash == hash && eq(slots[i].id)) {
+      // The newest entry is prefered since it has the lowest index
+      break;
+    }
   }
-  return std::strong_ordering::greater;
+  slots[i] = {id, hash};
 }
-} // namespace std
 
-namespace rfc7541 {
+void indexed_dynamic_table::hash_index::erase(uint64_t id, std::size_t hash) noexcept {
+  auto i = hash & mask;
+  for (; slots[i].id != id; i = (i + 1) & mask) {
+    if (slots[i].id == NoEntry) {
+      // A key is already refered by a newer entry
+      return;
+    }
+  }
 
-bool indexed_dynamic_table::index_comparator::operator()(const record *lhs, const record *rhs) const {
-  return std::tie(lhs->name, lhs->value) < std::tie(rhs->name, rhs->value);
+  // Move back all following slots those can't be found without the erased one
+  for (auto j = (i + 1) & mask; slots[j].id != NoEntry; j = (j + 1) & mask) {
+    auto home = slots[j].hash & mask;
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i].id = NoEntry;
 }
 
-bool indexed_dynamic_table::index_comparator::operator()(const record *lhs, const name_value_t &rhs) const {
-  const auto name_span = lhs->name;
-  const auto value_span = lhs->value;
-  return std::tie(name_span, value_span) < std::tie(rhs.first, rhs.second);
-}
+indexed_dynamic_table::indexed_dynamic_table(std::size_t max_size) : dynamic_table(max_size) { reserve(max_size); }
+
+indexed_dynamic_table::~indexed_dynamic_table() = default;
 
 void indexed_dynamic_table::insert(const std::span<const uint8_t> name, const std::span<const uint8_t> value) {
-  record r{};
-  r.name.assign(name.begin(), name.end());
-  r.value.assign(value.begin(), value.end());
-  auto hsize = r.hpack_size();
-
-  auto rq_size = (hsize > hpack_max_size) ? 0 : hpack_max_size - hsize;
-  auto it = shrink_to(rq_size);
-  std::for_each(it, table.end(), [this](const auto &r) { index_set.erase(&r); });
-  table.erase(it, table.end());
-
-  insert_impl(std::move(r));
-  index_set.insert(&table.front());
+  auto name_hash = hash_bytes(name);
+  entry_hashes h{name_hash, hash_field(name_hash, value)};
+
+  if (dynamic_table::insert(name, value, [this](uint64_t id) { on_evict(id); })) {
+    auto id = newest_id();
+    hashes[id & hashes_mask] = h;
+    index_entry(id);
+  }
 }
 
 void indexed_dynamic_table::update_size(std::size_t size) {
-  auto it = shrink_to(size);
-  std::for_each(it, table.end(), [this](const auto &r) { index_set.erase(&r); });
-  table.erase(it, table.end());
-  hpack_max_size = size;
+  dynamic_table::update_size(size, [this](uint64_t id) { on_evict(id); });
+  reserve(size);
 }
 
 std::pair<int, bool> indexed_dynamic_table::field_index(const std::span<const uint8_t> name,
                                                         const std::span<const uint8_t> value) {
-  auto it = index_set.lower_bound(std::make_pair(name, value));
-  if (it == index_set.end()) {
+  if (size() == 0) {
     return {-1, false};
   }
-  int i = -1;
-  bool has_value = false;
-  const auto *record = *it;
-  using span_type = decltype(name);
-  if (std::strong_ordering::equal == (span_type(record->name) <=> name)) {
-    i = record_index(*it);
-    has_value = std::strong_ordering::equal == (span_type(record->value) <=> value);
+
+  auto name_hash = hash_bytes(name);
+  auto id = by_field.find(hash_field(name_hash, value), [&](uint64_t id) {
+    auto [entry_name, entry_value] = fields(entry_by_id(id));
+    return equal(entry_name, name) && equal(entry_value, value);
+  });
+  if (id != hash_index::NoEntry) {
+    return {static_cast<int>(id_to_index(id)), true};
+  }
+
+  id = by_name.find(name_hash, [&](uint64_t id) { return equal(fields(entry_by_id(id)).first, name); });
+  if (id != hash_index::NoEntry) {
+    return {static_cast<int>(id_to_index(id)), false};
+  }
+  return {-1, false};
+}
+
+void indexed_dynamic_table::reserve(std::size_t size) {
+  auto capacity = entries_capacity(size);
+  if (hashes && capacity <= hashes_mask + 1) {
+    return;
+  }
+
+  std::unique_ptr<entry_hashes[]> new_hashes(new entry_hashes[capacity]);
+  for (auto id = oldest_id(); id != oldest_id() + this->size(); ++id) {
+    new_hashes[id & (capacity - 1)] = hashes[id & hashes_mask];
+  }
+  hashes = std::move(new_hashes);
+  hashes_mask = capacity - 1;
+
+  // Load factor is not greater than 0.5
+  by_name.reset(capacity * 2);
+  by_field.reset(capacity * 2);
+  for (auto id = oldest_id(); id != oldest_id() + this->size(); ++id) {
+    index_entry(id);
   }
-  return {i, has_value};
+}
+
+void indexed_dynamic_table::on_evict(uint64_t id) noexcept {
+  const auto &h = hashes[id & hashes_mask];
+  by_name.erase(id, h.name);
+  by_field.erase(id, h.field);
+}
+
+void indexed_dynamic_table::index_entry(uint64_t id) {
+  const auto &h = hashes[id & hashes_mask];
+  auto [name, value] = fields(entry_by_id(id));
+  by_name.insert(id, h.name, [&](uint64_t other) { return equal(fields(entry_by_id(other)).first, name); });
+  by_field.insert(id, h.field, [&](uint64_t other) {
+    auto [other_name, other_value] = fields(entry_by_id(other));
+    return equal(other_name, name) && equal(other_value, value);
+  });
 }
 
 } // namespace rfc7541
@@ -1,19 +1,25 @@
 #pragma once
 
-#include <set>
+#include <memory>
 
 #include "dynamic_table.h"
 
 namespace rfc7541 {
 
+/**
+ * @brief The indexed_dynamic_table class is a dynamic table with a search by a name and a value.
+ * There are two open addressing hash indexes: by a name and by a name + value pair.
+ * Every index slot keeps an id of the newest entry with a given key. Hashes are calculated once per entry,
+ * so an eviction doesn't touch entry data and both an insertion and an eviction never allocate.
+ */
 class indexed_dynamic_table : public dynamic_table {
 public:
-  explicit indexed_dynamic_table(std::size_t max_size) : dynamic_table(max_size) {}
+  explicit indexed_dynamic_table(std::size_t max_size);
 
   indexed_dynamic_table() = delete;
   indexed_dynamic_table(const indexed_dynamic_table &) = delete;
   indexed_dynamic_table(indexed_dynamic_table &&) = default;
-  ~indexed_dynamic_table() = default;
+  ~indexed_dynamic_table();
 
   void insert(const std::span<const uint8_t> name, const std::span<const uint8_t> value);
   void update_size(std::size_t size);
@@ -21,14 +27,41 @@ public:
   std::pair<int, bool> field_index(const std::span<const uint8_t> name, const std::span<const uint8_t> value);
 
 private:
-  struct index_comparator {
-    using is_transparent = void;
+  /**
+   * @brief The hash_index class is a linear probing hash set of entry ids.
+   * Erasing uses a backward shift, so there are no tombstones.
+   */
+  class hash_index {
+  public:
+    static constexpr uint64_t NoEntry = ~uint64_t(0);
 
-    bool operator()(const record *lhs, const record *rhs) const;
-    using name_value_t = std::pair<const std::span<const uint8_t>, const std::span<const uint8_t>>;
-    bool operator()(const record *lhs, const name_value_t &rhs) const;
+    void reset(std::size_t capacity);
+    template <typename Eq> uint64_t find(std::size_t hash, Eq &&eq) const;
+    template <typename Eq> void insert(uint64_t id, std::size_t hash, Eq &&eq);
+    void erase(uint64_t id, std::size_t hash) noexcept;
+
+  private:
+    struct slot {
+      uint64_t id = NoEntry;
+      std::size_t hash = 0;
+    };
+    std::unique_ptr<slot[]> slots;
+    std::size_t mask = 0;
+  };
+
+  struct entry_hashes {
+    std::size_t name;
+    std::size_t field;
   };
 
-  std::set<const record *, index_comparator> index_set;
+  void reserve(std::size_t size);
+  void on_evict(uint64_t id) noexcept;
+  void index_entry(uint64_t id);
+
+  // Hashes of entries by their ids. The capacity is a power of 2
+  std::unique_ptr<entry_hashes[]> hashes;
+  std::size_t hashes_mask = 0;
+  hash_index by_name;
+  hash_index by_field;
 };
 } // namespace rfc7541
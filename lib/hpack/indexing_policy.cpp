@@ -0,0 +1,114 @@
+#include "indexing_policy.h"
+
+namespace rfc7541 {
+
+namespace {
+// Counters are halved when they reach this value, so old statistics fades out
+constexpr uint32_t DecayLimit = 1024;
+} // namespace
+
+adaptive_indexing_policy::adaptive_indexing_policy() : adaptive_indexing_policy(config{}) {}
+
+adaptive_indexing_policy::adaptive_indexing_policy(config &&c) : conf(std::move(c)) {
+  for (const auto &[name, rule] : conf.name_rules) {
+    names[name].rule = rule;
+  }
+}
+
+adaptive_indexing_policy::~adaptive_indexing_policy() = default;
+
+literal_decision adaptive_indexing_policy::decide(const header_field &field, std::size_t table_size) const {
+  auto make = [](bool index, reason r) { return literal_decision{index, static_cast<uint8_t>(r)}; };
+
+  if (field.hpack_size() * 100 > table_size * conf.max_entry_rate) {
+    return make(false, reason::TOO_LARGE);
+  }
+
+  // A new name is indexed. Its statistics is created when the field is written
+  const auto *s = find_stats(field.name_view());
+  if (s == nullptr) {
+    return make(true, reason::INDEXED);
+  }
+
+  switch (s->rule) {
+  case name_rule::NEVER:
+    return make(false, reason::BY_NAME_RULE);
+  case name_rule::ALWAYS:
+    return make(true, reason::INDEXED);
+  case name_rule::AUTO:
+    break;
+  }
+
+  if (s->inserts >= conf.warmup && s->hits * 100 < s->inserts * conf.min_hit_rate) {
+    const bool probe = conf.probe_interval != 0 && (s->skipped + 1) % conf.probe_interval == 0;
+    return probe ? make(true, reason::PROBE) : make(false, reason::LOW_REUSE);
+  }
+  return make(true, reason::INDEXED);
+}
+
+bool adaptive_indexing_policy::huffman(std::size_t raw_size, std::size_t huffman_size) const {
+  return huffman_size < raw_size && (raw_size < 10 || (100 * huffman_size / raw_size) <= conf.min_huffman_rate);
+}
+
+void adaptive_indexing_policy::on_encoded(const header_field &field, const literal_decision &decision) {
+  switch (static_cast<reason>(decision.reason)) {
+  case reason::TOO_LARGE:
+    ++stats.too_large;
+    return;
+  case reason::BY_NAME_RULE:
+    ++stats.by_name_rule;
+    return;
+  case reason::LOW_REUSE:
+    ++find_stats(field.name_view(), false)->skipped;
+    ++stats.low_reuse;
+    return;
+  case reason::INDEXED:
+  case reason::PROBE:
+    break;
+  }
+
+  ++stats.indexed;
+  auto *s = find_stats(field.name_view(), true);
+  if (s == nullptr || s->rule != name_rule::AUTO) {
+    return;
+  }
+  if (static_cast<reason>(decision.reason) == reason::PROBE) {
+    ++s->skipped;
+  }
+  if (++s->inserts == DecayLimit) {
+    s->inserts /= 2;
+    s->hits /= 2;
+  }
+}
+
+void adaptive_indexing_policy::on_hit(const header_field &field) {
+  ++stats.hits;
+  if (auto *s = find_stats(field.name_view(), false); s != nullptr && s->hits < s->inserts) {
+    ++s->hits;
+  }
+}
+
+void adaptive_indexing_policy::on_string(bool is_huffman) {
+  if (is_huffman) {
+    ++stats.huffman;
+  } else {
+    ++stats.raw;
+  }
+}
+
+adaptive_indexing_policy::name_stats *adaptive_indexing_policy::find_stats(std::string_view name, bool create) {
+  if (auto it = names.find(name); it != names.end()) {
+    return &it->second;
+  }
+  if (!create || names.size() >= conf.max_tracked_names) {
+    return nullptr;
+  }
+  return &names.emplace(name, name_stats{}).first->second;
+}
+
+const adaptive_indexing_policy::name_stats *adaptive_indexing_policy::find_stats(std::string_view name) const {
+  auto it = names.find(name);
+  return it != names.end() ? &it->second : nullptr;
+}
+
+} // namespace rfc7541
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "header_field.h"
+
+namespace rfc7541 {
+
+/**
+ * @brief The indexing_counters struct contains encoder decisions made by an indexing policy.
+ */
+struct indexing_counters {
+  uint64_t indexed = 0;      // Literals inserted into the dynamic table
+  uint64_t hits = 0;         // Fields found in the dynamic table
+  uint64_t too_large = 0;    // Not indexed since a field is too large for the table
+  uint64_t by_name_rule = 0; // Not indexed by a name rule
+  uint64_t low_reuse = 0;    // Not indexed since values with the same name are rarely reused
+  uint64_t huffman = 0;      // Strings encoded with Huffman codes
+  uint64_t raw = 0;          // Strings encoded as is
+};
+
+/**
+ * @brief The literal_decision struct is a representation of a literal chosen by an indexing policy.
+ */
+struct literal_decision {
+  bool index = false; // true for a literal with incremental indexing and false for a literal without indexing
+  uint8_t reason = 0; // A policy defined value that is passed back into on_encoded
+};
+
+/**
+ * @brief The indexing_policy class decides how an encoder represents fields.
+ * It is called only for fields with 'index_type::DEFAULT'. Other types are always respected.
+ * Decisions have no side effects since a field can be left for the next header block fragment.
+ * Statistics are updated only for fields those are written.
+ */
+class indexing_policy {
+public:
+  virtual ~indexing_policy() = default;
+
+  /**
+   * @brief decide is called for a field that isn't found in tables.
+   * @param table_size is a current max size of the dynamic table
+   */
+  virtual literal_decision decide(const header_field &field, std::size_t table_size) const = 0;
+
+  /**
+   * @brief huffman chooses a string encoding.
+   * @param raw_size is a size of a string
+   * @param huffman_size is a size of a Huffman encoded string
+   * @return true to use Huffman encoding
+   */
+  virtual bool huffman(std::size_t raw_size, std::size_t huffman_size) const = 0;
+
+  /**
+   * @brief on_encoded is called when a literal that is represented by 'decision' is written.
+   */
+  virtual void on_encoded(const header_field &field, const literal_decision &decision) = 0;
+
+  /**
+   * @brief on_hit is called when a field that is found in the dynamic table is written.
+   */
+  virtual void on_hit(const header_field &field) = 0;
+
+  /**
+   * @brief on_string is called for every written string of literals with any index type.
+   */
+  virtual void on_string(bool is_huffman) = 0;
+
+  virtual const indexing_counters &counters() const noexcept = 0;
+};
+
+/**
+ * @brief The adaptive_indexing_policy class is a default indexing policy.
+ * A field isn't indexed when:
+ * - it takes more than 'max_entry_rate' of the dynamic table;
+ * - it has a name with 'name_rule::NEVER';
+ * - values with the same name are rarely found in the table. I. e. after 'warmup' insertions
+ *   hits are less than 'min_hit_rate' of insertions. Such names are probed again once per 'probe_interval' fields.
+ *   'probe_interval' 0 disables probes.
+ */
+class adaptive_indexing_policy : public indexing_policy {
+public:
+  enum class name_rule : uint8_t {
+    AUTO,
+    ALWAYS,
+    NEVER,
+  };
+
+  struct config {
+    std::size_t max_entry_rate = 25;  // in percents of the table size
+    std::size_t min_huffman_rate = 90; // in percents
+    std::size_t min_hit_rate = 10;     // in percents of insertions
+    uint32_t warmup = 16;
+    uint32_t probe_interval = 64; // 0 means never probe
+    std::size_t max_tracked_names = 512;
+    std::vector<std::pair<std::string, name_rule>> name_rules = {
+        {"x-request-id", name_rule::NEVER},  {"x-correlation-id", name_rule::NEVER}, {"traceparent", name_rule::NEVER},
+        {"tracestate", name_rule::NEVER},    {"x-b3-traceid", name_rule::NEVER},     {"x-b3-spanid", name_rule::NEVER},
+        {"x-amzn-trace-id", name_rule::NEVER}, {"date", name_rule::NEVER},
+    };
+  };
+
+  adaptive_indexing_policy();
+  explicit adaptive_indexing_policy(config &&conf);
+  adaptive_indexing_policy(const adaptive_indexing_policy &) = delete;
+  adaptive_indexing_policy(adaptive_indexing_policy &&) = default;
+  ~adaptive_indexing_policy() override;
+
+  literal_decision decide(const header_field &field, std::size_t table_size) const override;
+  bool huffman(std::size_t raw_size, std::size_t huffman_size) const override;
+  void on_encoded(const header_field &field, const literal_decision &decision) override;
+  void on_hit(const header_field &field) override;
+  void on_string(bool is_huffman) override;
+  const indexing_counters &counters() const noexcept override { return stats; }
+
+private:
+  enum class reason : uint8_t {
+    INDEXED,
+    PROBE, // Indexed to check whether values of a low reuse name are found again
+    TOO_LARGE,
+    BY_NAME_RULE,
+    LOW_REUSE,
+  };
+
+  struct name_stats {
+    name_rule rule = name_rule::AUTO;
+    uint32_t inserts = 0;
+    uint32_t hits = 0;
+    uint32_t skipped = 0;
+  };
+
+  struct string_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view>{}(str); }
+  };
+
+  name_stats *find_stats(std::string_view name, bool create);
+  const name_stats *find_stats(std::string_view name) const;
+
+  config conf;
+  indexing_counters stats;
+  std::unordered_map<std::string, name_stats, string_hash, std::equal_to<>> names;
+};
+
+} // namespace rfc7541
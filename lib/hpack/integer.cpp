@@ -1,43 +1,19 @@
 #include "integer.h"
 
+#include <bit>
+#include <cstring>
 #include <stdexcept>
 
-namespace rfc7541::integer {
-
-encoded_result encode(uint8_t init, unsigned bitlen, uint32_t src_value) {
-  if (src_value > MAX_HPACK_INT) {
-    throw std::overflow_error("A value must be less than 2^24-1");
-  }
+#include <boost/endian/conversion.hpp>
 
-  encoded_result result;
-  result.value[0] = init;
-
-  result.length = 1;
-  uint8_t mask = utils::make_mask<uint8_t>(8 - bitlen);
-  if (src_value < mask) {
-    result.value[0] |= uint8_t(src_value) & mask;
-    return result;
-  }
-
-  result.value[0] |= mask;
-  src_value -= mask;
-
-  while (src_value >= 0x80) {
-    result.value[result.length] = uint8_t(src_value) & 0x7f;
-    result.value[result.length] |= 0x80;
-    src_value /= 128;
-    result.length++;
-  };
-
-  result.value[result.length++] = uint8_t(src_value) & 0x7f;
-  return result;
-}
+namespace rfc7541::integer {
 
-decoded_result decode(unsigned bit_suffix_len, std::span<const uint8_t> init_src) {
-  if (init_src.empty() || bit_suffix_len > 4 || bit_suffix_len == 0) {
-    throw std::invalid_argument("A source can't be empty. A suffix len can't be greater 4");
-  }
+namespace {
+// Continuation flags of 1..4 bytes those follow a prefix. The last byte has no flag
+constexpr uint32_t ContinuationFlags[] = {0, 0, 0x80, 0x8080, 0x808080};
 
+// 'bit_suffix_len' and a source are validated by a caller
+decoded_result decode_slow(unsigned bit_suffix_len, std::span<const uint8_t> init_src) {
   uint64_t value = 0;
 
   uint8_t mask = utils::make_mask<uint8_t>(8 - bit_suffix_len);
@@ -52,7 +28,7 @@ decoded_result decode(unsigned bit_suffix_len, std::span<const uint8_t> init_src
   do {
     src = src.subspan(1);
     if (src.empty()) {
-      throw std::invalid_argument("A src has not enough data");
+      throw incomplete_input("A src has not enough data");
     }
 
     b = src.front();
@@ -65,5 +41,65 @@ decoded_result decode(unsigned bit_suffix_len, std::span<const uint8_t> init_src
 
   return {1 + unsigned(std::distance(init_src.begin(), src.begin())), uint32_t(value)};
 }
+} // namespace
+
+encoded_result encode(uint8_t init, unsigned bitlen, uint32_t src_value) {
+  if (src_value > MAX_HPACK_INT) {
+    throw std::overflow_error("A value must be less than 2^24-1");
+  }
+
+  encoded_result result;
+  uint8_t mask = utils::make_mask<uint8_t>(8 - bitlen);
+  if (src_value < mask) {
+    result.value[0] = init | uint8_t(src_value);
+    result.length = 1;
+    return result;
+  }
+
+  result.value[0] = init | mask;
+  src_value -= mask;
+
+  // 7 bits per byte. A value is less than 2^24, so there are up to 4 bytes
+  unsigned bytes = src_value == 0 ? 1 : (std::bit_width(src_value) + 6) / 7;
+  uint32_t spread = (src_value & 0x7f) | ((src_value << 1) & 0x7f00) | ((src_value << 2) & 0x7f0000) |
+                    ((src_value << 3) & 0x7f000000);
+  spread = boost::endian::native_to_little(spread | ContinuationFlags[bytes]);
+  memcpy(result.value + 1, &spread, sizeof(spread));
+  result.length = uint8_t(1 + bytes);
+  return result;
+}
+
+decoded_result decode_continued(unsigned bit_suffix_len, std::span<const uint8_t> src) {
+  if (bit_suffix_len - 1 >= 4) {
+    throw std::invalid_argument("A suffix len must be from 1 to 4");
+  }
+  if (src.empty()) {
+    throw incomplete_input("A source can't be empty");
+  }
+
+  uint8_t mask = utils::make_mask<uint8_t>(8 - bit_suffix_len);
+  if (src.size() >= sizeof(uint64_t) && (src.front() & mask) == mask) {
+    // A prefix and up to 7 following bytes by a single load
+    uint64_t word;
+    memcpy(&word, src.data(), sizeof(word));
+    word = boost::endian::little_to_native(word) >> 8;
+
+    // The last byte of an integer has no continuation flag
+    auto stops = ~word & 0x0080808080808080ull;
+    auto bytes = unsigned(std::countr_zero(stops)) / 8 + 1;
+    if (stops != 0 && bytes <= 4) {
+      word &= ~uint64_t(0) >> (64 - 8 * bytes);
+      uint64_t value = (word & 0x7f) | ((word >> 1) & 0x3f80) | ((word >> 2) & 0x1fc000) | ((word >> 3) & 0xfe00000);
+      value += mask;
+      if (value > MAX_HPACK_INT) {
+        throw std::overflow_error("An overflow in HPACK int decoding");
+      }
+      return {1 + bytes, uint32_t(value)};
+    }
+  }
+
+  // Near the end of a buffer and for redundant long encodings
+  return decode_slow(bit_suffix_len, src);
+}
 
 } // namespace rfc7541::integer
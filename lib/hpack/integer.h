@@ -2,10 +2,24 @@
 
 #include <cstdint>
 #include <span>
+#include <stdexcept>
 
 #include "constants.h"
 #include "utils/utils.h"
 
+namespace rfc7541 {
+
+/**
+ * @brief The incomplete_input class is thrown when a source ends in the middle of an integer or a string.
+ * A decoder keeps such a field until the next header block fragment.
+ */
+class incomplete_input : public std::invalid_argument {
+public:
+  using std::invalid_argument::invalid_argument;
+};
+
+} // namespace rfc7541
+
 namespace rfc7541::integer {
 
 struct encoded_result {
@@ -28,7 +42,26 @@ struct decoded_result {
   uint32_t value;
 };
 
-decoded_result decode(unsigned bit_suffix_len, std::span<const uint8_t> src);
+/**
+ * @brief decode_continued is an out of line part of 'decode' for integers those don't fit into a prefix.
+ * An integer of up to 5 bytes is decoded by a single 8 byte load when a source has enough bytes.
+ */
+decoded_result decode_continued(unsigned bit_suffix_len, std::span<const uint8_t> src);
+
+/**
+ * @brief decode decodes a prefixed integer. A value those fits into a prefix is decoded inline.
+ * @throw incomplete_input for a short source, std::overflow_error for a value greater than MAX_HPACK_INT
+ */
+inline decoded_result decode(unsigned bit_suffix_len, std::span<const uint8_t> src) {
+  if (!src.empty() && bit_suffix_len - 1 < 4) {
+    uint8_t mask = utils::make_mask<uint8_t>(8 - bit_suffix_len);
+    uint8_t value = src.front() & mask;
+    if (value < mask) {
+      return {1, value};
+    }
+  }
+  return decode_continued(bit_suffix_len, src);
+}
 
 constexpr auto MAX_HPACK_INT = (1 << 24) - 16;
 
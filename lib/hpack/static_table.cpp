@@ -1,212 +1,153 @@
 #include "static_table.h"
 
-#include <algorithm>
+#include <array>
 #include <cstring>
+#include <string_view>
 
 namespace {
 
-bool operator==(std::span<const char> lhs, std::span<const uint8_t> rhs) {
-  return 0 == memcmp(lhs.data(), rhs.data(), rhs.size_bytes());
-}
+struct static_field {
+  std::string_view name;
+  std::string_view value;
+};
 
-bool operator!=(std::span<const char> lhs, std::span<const uint8_t> rhs) {
-  return 0 != memcmp(lhs.data(), rhs.data(), rhs.size_bytes());
+// RFC 7541 Appendix A
+constexpr static_field field_table[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+// A hash key of a string is its size and 3 sampled bytes. Keys of static names and fields are unique
+template <typename S> constexpr uint64_t sample(const S &s) noexcept {
+  if (s.empty()) {
+    return 0;
+  }
+  return uint64_t(s.size()) | uint64_t(uint8_t(s[0])) << 32 | uint64_t(uint8_t(s[s.size() / 2])) << 40 |
+         uint64_t(uint8_t(s[s.size() - 1])) << 48;
 }
 
-consteval std::span<const char> operator""_sp(const char *str, std::size_t len) { return {str, len}; }
+template <typename S> constexpr uint64_t field_key(const S &name, const S &value) noexcept {
+  return sample(name) ^ (sample(value) * 0x9e3779b97f4a7c15ull);
+}
 
-struct static_field {
-  std::span<const char> name;
-  std::span<const char> value;
-};
+/**
+ * @brief The perfect_index struct maps keys of static entries into distinct slots by a multiplicative hash.
+ * So a lookup is a single probe and a single comparison.
+ */
+struct perfect_index {
+  static constexpr unsigned Bits = 9;
 
-static const static_field field_table[] = {
-    {":authority"_sp, ""_sp},
-    {":method"_sp, "GET"_sp},
-    {":method"_sp, "POST"_sp},
-    {":path"_sp, "/"_sp},
-    {":path"_sp, "/index.html"_sp},
-    {":scheme"_sp, "http"_sp},
-    {":scheme"_sp, "https"_sp},
-    {":status"_sp, "200"_sp},
-    {":status"_sp, "204"_sp},
-    {":status"_sp, "206"_sp},
-    {":status"_sp, "304"_sp},
-    {":status"_sp, "400"_sp},
-    {":status"_sp, "404"_sp},
-    {":status"_sp, "500"_sp},
-    {"accept-charset"_sp, ""_sp},
-    {"accept-encoding"_sp, "gzip, deflate"_sp},
-    {"accept-language"_sp, ""_sp},
-    {"accept-ranges"_sp, ""_sp},
-    {"accept"_sp, ""_sp},
-    {"access-control-allow-origin"_sp, ""_sp},
-    {"age"_sp, ""_sp},
-    {"allow"_sp, ""_sp},
-    {"authorization"_sp, ""_sp},
-    {"cache-control"_sp, ""_sp},
-    {"content-disposition"_sp, ""_sp},
-    {"content-encoding"_sp, ""_sp},
-    {"content-language"_sp, ""_sp},
-    {"content-length"_sp, ""_sp},
-    {"content-location"_sp, ""_sp},
-    {"content-range"_sp, ""_sp},
-    {"content-type"_sp, ""_sp},
-    {"cookie"_sp, ""_sp},
-    {"date"_sp, ""_sp},
-    {"etag"_sp, ""_sp},
-    {"expect"_sp, ""_sp},
-    {"expires"_sp, ""_sp},
-    {"from"_sp, ""_sp},
-    {"host"_sp, ""_sp},
-    {"if-match"_sp, ""_sp},
-    {"if-modified-since"_sp, ""_sp},
-    {"if-none-match"_sp, ""_sp},
-    {"if-range"_sp, ""_sp},
-    {"if-unmodified-since"_sp, ""_sp},
-    {"last-modified"_sp, ""_sp},
-    {"link"_sp, ""_sp},
-    {"location"_sp, ""_sp},
-    {"max-forwards"_sp, ""_sp},
-    {"proxy-authenticate"_sp, ""_sp},
-    {"proxy-authorization"_sp, ""_sp},
-    {"range"_sp, ""_sp},
-    {"referer"_sp, ""_sp},
-    {"refresh"_sp, ""_sp},
-    {"retry-after"_sp, ""_sp},
-    {"server"_sp, ""_sp},
-    {"set-cookie"_sp, ""_sp},
-    {"strict-transport-security"_sp, ""_sp},
-    {"transfer-encoding"_sp, ""_sp},
-    {"user-agent"_sp, ""_sp},
-    {"vary"_sp, ""_sp},
-    {"via"_sp, ""_sp},
-    {"www-authenticate"_sp, ""_sp},
-};
+  uint64_t seed = 0;
+  // 1-based indexes of static entries. 0 is an empty slot
+  std::array<uint8_t, 1 << Bits> slots{};
 
-static const unsigned char asso_values[] = {
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 10, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    15, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 1,  66, 8,  13, 2,  41, 15, 5,  19, 66, 23, 2,  4,  12, 32, 20, 66, 3,  21,
-    1,  23, 17, 32, 20, 14, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
-    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66};
-
-static const unsigned char lengthtable[] = {0,  0,  0,  3, 6,  6,  15, 4, 7,  14, 11, 7, 12, 16, 13, 8, 14,
-                                            4,  3,  13, 5, 5,  7,  16, 8, 13, 16, 13, 8, 7,  15, 10, 4, 6,
-                                            19, 13, 12, 7, 17, 10, 13, 6, 7,  18, 17, 4, 16, 27, 4,  4, 0,
-                                            0,  10, 19, 0, 0,  0,  25, 0, 0,  0,  0,  0, 19, 0,  5};
-
-struct item {
-  item(const char *) {}
-  item(const char *, int8_t s, int8_t e) : start(s), end(e) {}
-  int8_t start = -1;
-  int8_t end = -1;
+  constexpr uint8_t find(uint64_t key) const noexcept { return slots[(key * seed) >> (64 - Bits)]; }
 };
 
-static const item wordlist[] = {{""},
-                                {""},
-                                {""},
-                                {"age", 20, 20},
-                                {"accept", 18, 18},
-                                {"expect", 34, 34},
-                                {"accept-language", 16, 16},
-                                {"host", 37, 37},
-                                {"referer", 50, 50},
-                                {"accept-charset", 14, 14},
-                                {"retry-after", 52, 52},
-                                {"refresh", 51, 51},
-                                {"content-type", 30, 30},
-                                {"content-language", 26, 26},
-                                {"content-range", 29, 29},
-                                {"location", 45, 45},
-                                {"content-length", 27, 27},
-                                {"date", 32, 32},
-                                {"via", 59, 59},
-                                {"authorization", 22, 22},
-                                {"range", 49, 49},
-                                {":path", 3, 4},
-                                {":scheme", 5, 6},
-                                {"content-location", 28, 28},
-                                {"if-range", 41, 41},
-                                {"accept-ranges", 17, 17},
-                                {"content-encoding", 25, 25},
-                                {"cache-control", 23, 23},
-                                {"if-match", 38, 38},
-                                {":method", 1, 2},
-                                {"accept-encoding", 15, 15},
-                                {":authority", 0, 0},
-                                {"etag", 33, 33},
-                                {"cookie", 31, 31},
-                                {"content-disposition", 24, 24},
-                                {"last-modified", 43, 43},
-                                {"max-forwards", 46, 46},
-                                {":status", 7, 13},
-                                {"transfer-encoding", 56, 56},
-                                {"user-agent", 57, 57},
-                                {"if-none-match", 40, 40},
-                                {"server", 53, 53},
-                                {"expires", 35, 35},
-                                {"proxy-authenticate", 47, 47},
-                                {"if-modified-since", 39, 39},
-                                {"vary", 58, 58},
-                                {"www-authenticate", 60, 60},
-                                {"access-control-allow-origin", 19, 19},
-                                {"link", 44, 44},
-                                {"from", 36, 36},
-                                "",
-                                "",
-                                {"set-cookie", 54, 54},
-                                {"proxy-authorization", 48, 48},
-                                "",
-                                "",
-                                "",
-                                {"strict-transport-security", 55, 55},
-                                "",
-                                "",
-                                "",
-                                "",
-                                "",
-                                {"if-unmodified-since", 42, 42},
-                                "",
-                                {"allow", 21, 21}};
-
-std::pair<int, int> index(const std::span<const uint8_t> name) {
-  enum { TOTAL_KEYWORDS = 52, MIN_WORD_LENGTH = 3, MAX_WORD_LENGTH = 27, MIN_HASH_VALUE = 3, MAX_HASH_VALUE = 65 };
-
-  if (name.size() < MIN_WORD_LENGTH || name.size() > MAX_WORD_LENGTH) {
-    return {-1, -1};
+// Searches for a seed those has no collisions. A compilation fails when it isn't found
+consteval perfect_index make_index(bool by_name) {
+  uint64_t seed = 0x9e3779b97f4a7c15ull;
+  for (int attempt = 0; attempt < 10000; ++attempt) {
+    seed = (seed * 6364136223846793005ull + 1442695040888963407ull) | 1;
+    perfect_index index{seed, {}};
+    bool collision = false;
+    for (std::size_t i = 0; i < std::size(field_table) && !collision; ++i) {
+      const auto &f = field_table[i];
+      if (by_name && i != 0 && field_table[i - 1].name == f.name) {
+        // Entries with the same name are adjacent. A name refers to the first one
+        continue;
+      }
+      auto key = by_name ? sample(f.name) : field_key(f.name, f.value);
+      auto &slot = index.slots[(key * seed) >> (64 - perfect_index::Bits)];
+      collision = slot != 0;
+      slot = static_cast<uint8_t>(i + 1);
+    }
+    if (!collision) {
+      return index;
+    }
   }
+  throw "A perfect hash seed isn't found";
+}
 
-  const unsigned char *str = name.data();
-  unsigned int hval = 0;
-
-  switch (name.size()) {
-  default:
-    hval += asso_values[str[8]];
-  /*FALLTHROUGH*/
-  case 8:
-  case 7:
-  case 6:
-  case 5:
-  case 4:
-    hval += asso_values[str[3]];
-  /*FALLTHROUGH*/
-  case 3:
-  case 2:
-  case 1:
-    hval += asso_values[str[0]];
-    break;
+// Entries with the same name are adjacent. So the first one is found by a backward scan
+consteval std::array<uint8_t, std::size(field_table)> make_first_name_indexes() {
+  std::array<uint8_t, std::size(field_table)> indexes{};
+  for (std::size_t i = 0; i < std::size(field_table); ++i) {
+    indexes[i] = i != 0 && field_table[i - 1].name == field_table[i].name ? indexes[i - 1] : uint8_t(i + 1);
   }
-  auto key = hval + asso_values[str[name.size() - 1]];
+  return indexes;
+}
 
-  if (key <= MAX_HASH_VALUE && name.size() == lengthtable[key]) {
-    return {wordlist[key].start, wordlist[key].end};
-  }
-  return {-1, -1};
+constexpr auto first_name_indexes = make_first_name_indexes();
+constexpr perfect_index names_index = make_index(true);
+constexpr perfect_index fields_index = make_index(false);
+
+bool equal(std::string_view lhs, std::span<const uint8_t> rhs) noexcept {
+  return lhs.size() == rhs.size() && (rhs.empty() || 0 == memcmp(lhs.data(), rhs.data(), rhs.size()));
+}
+
+int find_name(std::span<const uint8_t> name) noexcept {
+  auto i = names_index.find(sample(name));
+  return i != 0 && equal(field_table[i - 1].name, name) ? i : -1;
 }
 } // namespace
 
@@ -217,34 +158,20 @@ std::size_t size() noexcept { return std::size(field_table); }
 
 std::pair<std::span<const uint8_t>, std::span<const uint8_t>> at(std::size_t index) noexcept {
   const auto &[name, value] = field_table[index - 1];
-  return {{reinterpret_cast<const uint8_t *>(name.data()), name.size_bytes()},
-          {reinterpret_cast<const uint8_t *>(value.data()), value.size_bytes()}};
+  return {{reinterpret_cast<const uint8_t *>(name.data()), name.size()},
+          {reinterpret_cast<const uint8_t *>(value.data()), value.size()}};
 }
 
-int name_index(const std::span<const uint8_t> name) noexcept {
-  auto [start, end] = index(name);
-  if (start < 0 || field_table[start].name != name) {
-    return -1;
-  }
-  return start + 1;
-}
+int name_index(const std::span<const uint8_t> name) noexcept { return find_name(name); }
 
-std::pair<int, bool> field_index(const std::span<const uint8_t> name, const std::span<const uint8_t> value) noexcept {
-  auto [start, end] = index(name);
-  if (start < 0 || field_table[start].name != name) {
-    return {-1, false};
-  }
+int first_name_index(std::size_t index) noexcept { return first_name_indexes[index - 1]; }
 
-  // Searching in the value diapason
-  auto *end_ptr = &field_table[end + 1];
-  if (auto it = std::find_if(&field_table[start], end_ptr,
-                             [value](const static_field &field) {
-                               return field.value.size_bytes() == value.size_bytes() && field.value == value;
-                             });
-      it != end_ptr) {
-    return {1 + std::distance(&field_table[0], it), true};
+std::pair<int, bool> field_index(const std::span<const uint8_t> name, const std::span<const uint8_t> value) noexcept {
+  auto i = fields_index.find(field_key(name, value));
+  if (i != 0 && equal(field_table[i - 1].value, value) && equal(field_table[i - 1].name, name)) {
+    return {i, true};
   }
-  return {++start, false};
+  return {find_name(name), false};
 }
 
 } // namespace static_table
@@ -11,6 +11,12 @@ std::size_t size() noexcept;
 std::pair<std::span<const uint8_t>, std::span<const uint8_t>> at(std::size_t index) noexcept;
 
 int name_index(const std::span<const uint8_t> name) noexcept;
+
+/**
+ * @brief first_name_index
+ * @return the first index of an entry with the same name as the entry 'index'. 'index' must be valid
+ */
+int first_name_index(std::size_t index) noexcept;
 std::pair<int, bool> field_index(const std::span<const uint8_t> name, const std::span<const uint8_t> value) noexcept;
 
 } // namespace rfc7541::static_table
@@ -2,7 +2,6 @@
 
 #include <stdexcept>
 
-#include "bitstream.h"
 #include "constants.h"
 #include "huffman.h"
 #include "integer.h"
@@ -11,75 +10,87 @@ namespace rfc7541::string {
 
 namespace {
 std::vector<uint8_t> read_huffman_str(std::span<const uint8_t> src) {
-  ibitstream stream(src);
-  std::vector<uint8_t> result;
-
-  // FIXME: len is an  encoded byte size.
-  // The real size can be greater
-  result.reserve(src.size_bytes() + src.size_bytes() / 2);
-
-  auto codeLengths = rfc7541::huffman::allowed_code_lengths();
-  while (!stream.empty()) {
-    if (src.size_bytes() * 8 - stream.pos() < 8) {
-      // Check EOS padding
-      auto mask = utils::make_mask<uint8_t>(src.size_bytes() * 8 - stream.pos());
-      if (mask == (src.back() & mask)) {
-        return result;
-      }
-    }
-
-    uint32_t hcode{};
-    std::optional<rfc7541::huffman::value_type> index;
-    uint8_t code_len{};
-    for (auto bit_len : codeLengths) {
-      hcode = stream.take_bits(bit_len);
-      index = rfc7541::huffman::decode({hcode, bit_len});
-      if (index) {
-        code_len = bit_len;
-        break;
-      }
-    }
-
-    if (!index) {
-      throw std::invalid_argument("Can't decode huffman code");
-    }
-
-    if (index.value() == rfc7541::huffman::EOS) {
-      return result;
-    }
-    result.push_back(uint8_t(index.value()));
-    stream.commit_bits(code_len);
+  std::vector<uint8_t> result(huffman::max_decoded_size(src.size_bytes()));
+
+  huffman::decode_state state;
+  auto *last = huffman::decode(src, result.data(), state);
+  if (!state.accepted) {
+    throw std::invalid_argument("Invalid huffman string padding");
   }
-  result.shrink_to_fit();
+
+  result.resize(std::distance(result.data(), last));
   return result;
 }
 
-} // namespace
+std::span<const uint8_t> read_huffman_str(std::span<const uint8_t> src, arena &storage) {
+  auto result = storage.allocate(huffman::max_decoded_size(src.size_bytes()));
 
-decoded_result decode(std::span<const uint8_t> src) {
-  if (src.empty()) {
-    throw std::invalid_argument("A source can't be empty");
+  huffman::decode_state state;
+  auto *last = huffman::decode(src, result.data(), state);
+  if (!state.accepted) {
+    throw std::invalid_argument("Invalid huffman string padding");
   }
 
-  decoded_result result;
+  auto size = std::distance(result.data(), last);
+  storage.shrink(result, size);
+  return result.first(size);
+}
 
-  bool is_huffman = src[0] & uint8_t(constants::string_flag::ENCODED);
+struct string_info {
+  bool is_huffman;
+  integer::decoded_result length;
+};
+
+string_info read_string_info(std::span<const uint8_t> src) {
+  if (src.empty()) {
+    throw incomplete_input("A source can't be empty");
+  }
 
+  bool is_huffman = src[0] & uint8_t(constants::string_flag::ENCODED);
   auto str_length = integer::decode(1, src);
-  src = src.subspan(str_length.used_bytes);
 
-  if (src.size_bytes() < str_length.value) {
-    throw std::invalid_argument("Not enough input data for string");
+  if (src.size_bytes() - str_length.used_bytes < str_length.value) {
+    throw incomplete_input("Not enough input data for string");
   }
+  return {is_huffman, str_length};
+}
 
+} // namespace
+
+decoded_result decode(std::span<const uint8_t> src) {
+  auto [is_huffman, str_length] = read_string_info(src);
+  src = src.subspan(str_length.used_bytes, str_length.value);
+
+  decoded_result result;
   if (!is_huffman) {
-    result.value.assign(src.begin(), src.begin() + str_length.value);
+    result.value.assign(src.begin(), src.end());
   } else {
-    result.value = read_huffman_str(src.subspan(0, str_length.value));
+    result.value = read_huffman_str(src);
   }
 
   result.used_bytes = str_length.used_bytes + str_length.value;
   return result;
 }
 
+decoded_view decode(std::span<const uint8_t> src, arena &storage) {
+  auto [is_huffman, str_length] = read_string_info(src);
+  src = src.subspan(str_length.used_bytes, str_length.value);
+
+  return {str_length.used_bytes + str_length.value, is_huffman ? read_huffman_str(src, storage) : src};
+}
+
+encoded_view read_encoded(std::span<const uint8_t> src) {
+  auto [is_huffman, str_length] = read_string_info(src);
+  src = src.subspan(str_length.used_bytes, str_length.value);
+  if (is_huffman && !huffman::validate(src)) {
+    throw std::invalid_argument("Invalid huffman string");
+  }
+  return {str_length.used_bytes + str_length.value, src, is_huffman};
+}
+
+uint32_t skip(std::span<const uint8_t> src) {
+  auto str_length = read_string_info(src).length;
+  return str_length.used_bytes + str_length.value;
+}
+
 } // namespace rfc7541::string
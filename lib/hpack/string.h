@@ -4,6 +4,7 @@
 #include <span>
 #include <vector>
 
+#include "arena.h"
 #include "utils/utils.h"
 
 namespace rfc7541::string {
@@ -24,4 +25,32 @@ struct decoded_result {
 
 decoded_result decode(std::span<const uint8_t> src);
 
+struct decoded_view {
+  uint32_t used_bytes;
+  std::span<const uint8_t> value;
+};
+
+/**
+ * @brief decode decodes a string with no copying when it is possible.
+ * A string that is stored as is points into 'src'. A Huffman encoded string is decoded into the 'storage'.
+ */
+decoded_view decode(std::span<const uint8_t> src, arena &storage);
+
+struct encoded_view {
+  uint32_t used_bytes;
+  std::span<const uint8_t> value;
+  bool is_huffman;
+};
+
+/**
+ * @brief read_encoded returns a string as it is encoded. A Huffman encoded string is validated but isn't decoded.
+ */
+encoded_view read_encoded(std::span<const uint8_t> src);
+
+/**
+ * @brief skip checks a string without decoding it.
+ * @return a count of bytes used by the encoded string
+ */
+uint32_t skip(std::span<const uint8_t> src);
+
 } // namespace rfc7541::string
@@ -0,0 +1,74 @@
+#include "read_buffer_pool.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace http2 {
+
+utils::buffer read_buffer_pool::acquire(std::size_t min_size) {
+  auto size = std::max(buffer_size(), min_size);
+  {
+    std::scoped_lock lock(free_mutex);
+    if (!free_buffers.empty() && free_buffers.back().max_size() >= size) {
+      auto buff = std::move(free_buffers.back());
+      free_buffers.pop_back();
+      return buff;
+    }
+  }
+  return utils::buffer(size);
+}
+
+void read_buffer_pool::release(utils::buffer &&buff) {
+  // Only buffers of the current size are recycled. Others are freed
+  if (buff.max_size() != buffer_size()) {
+    return;
+  }
+
+  buff.consume(buff.data_view().size_bytes());
+  std::scoped_lock lock(free_mutex);
+  if (free_buffers.size() < MaxPooled) {
+    free_buffers.emplace_back(std::move(buff));
+  }
+}
+
+std::shared_ptr<const utils::buffer> read_buffer_pool::make_slab(utils::buffer &&buff) {
+  auto recycle = [pool = shared_from_this()](utils::buffer *slab) {
+    pool->release(std::move(*slab));
+    delete slab;
+  };
+  return std::shared_ptr<const utils::buffer>(new utils::buffer(std::move(buff)), std::move(recycle));
+}
+
+void read_buffer_pool::on_read(std::size_t bytes, std::size_t room) {
+  auto size = buffer_size();
+  if (bytes == room && room >= size) {
+    // A socket has more data than a buffer can take
+    set_buffer_size(size * 2);
+  } else if (bytes < size / SmallReadRatio) {
+    if (++small_reads == SmallReadsToShrink) {
+      set_buffer_size(size / 2);
+    }
+  } else {
+    small_reads = 0;
+  }
+}
+
+void read_buffer_pool::on_frame_size(std::size_t size) {
+  if (size > buffer_size()) {
+    set_buffer_size(std::bit_ceil(size));
+  }
+}
+
+void read_buffer_pool::set_buffer_size(std::size_t size) {
+  small_reads = 0;
+  size = std::clamp(size, MinSize, MaxSize);
+  if (size == buffer_size()) {
+    return;
+  }
+
+  target_size.store(size, std::memory_order_relaxed);
+  std::scoped_lock lock(free_mutex);
+  free_buffers.clear();
+}
+
+} // namespace http2
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils/buffer.h"
+
+namespace http2 {
+
+/**
+ * @brief The read_buffer_pool class provides socket read buffers.
+ * A buffer size follows reads: it grows when a read fills a whole buffer or a frame doesn't fit,
+ * and shrinks after a series of small reads. Buffers of the current size are recycled.
+ * Slabs of received DATA frames come back to the pool when the last slice is released.
+ * It may happen in any thread, so the free list is protected by a mutex.
+ */
+class read_buffer_pool : public std::enable_shared_from_this<read_buffer_pool> {
+public:
+  static constexpr std::size_t MinSize = 16 * 1024;
+  static constexpr std::size_t MaxSize = 256 * 1024;
+  // Count of buffers that are kept for recycling
+  static constexpr std::size_t MaxPooled = 8;
+  // Reads smaller than a buffer size / SmallReadRatio in a row make the buffer size smaller
+  static constexpr std::size_t SmallReadRatio = 8;
+  static constexpr std::size_t SmallReadsToShrink = 16;
+  // DATA frames smaller than slice_threshold are copied instead of being sliced.
+  // So a small retained frame doesn't keep a much bigger slab alive, while full size frames are never copied
+  static constexpr std::size_t MinSliceRatio = 8;
+  static constexpr std::size_t MaxCopySize = 2 * 1024;
+
+  read_buffer_pool() = default;
+  read_buffer_pool(const read_buffer_pool &) = delete;
+  read_buffer_pool(read_buffer_pool &&) = delete;
+  ~read_buffer_pool() = default;
+
+  /**
+   * @brief acquire returns an empty buffer of the current size or 'min_size' when it is greater.
+   */
+  [[nodiscard]] utils::buffer acquire(std::size_t min_size = 0);
+
+  /**
+   * @brief release gives a buffer back. Its data is dropped.
+   */
+  void release(utils::buffer &&buff);
+
+  /**
+   * @brief make_slab makes a shared buffer that is released to the pool with the last reference.
+   */
+  [[nodiscard]] std::shared_ptr<const utils::buffer> make_slab(utils::buffer &&buff);
+
+  /**
+   * @brief on_read adapts the buffer size to a completed read.
+   * @param bytes is a count of read bytes
+   * @param room is a count of bytes that the read could store
+   */
+  void on_read(std::size_t bytes, std::size_t room);
+
+  /**
+   * @brief on_frame_size grows the buffer size up to a size of a frame that doesn't fit into a buffer.
+   */
+  void on_frame_size(std::size_t size);
+
+  std::size_t buffer_size() const noexcept { return target_size.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief slice_threshold
+   * @return a min size of a DATA frame that is sliced from a buffer of 'buffer_size' bytes
+   */
+  static constexpr std::size_t slice_threshold(std::size_t buffer_size) noexcept {
+    return std::min(buffer_size / MinSliceRatio, MaxCopySize);
+  }
+
+private:
+  void set_buffer_size(std::size_t size);
+
+private:
+  std::atomic<std::size_t> target_size = MinSize;
+  std::size_t small_reads = 0;
+
+  std::mutex free_mutex;
+  std::vector<utils::buffer> free_buffers;
+};
+
+} // namespace http2
@@ -34,20 +34,41 @@ request::request(const boost::url &u, http2::method m) {
 
 request::~request() = default;
 
+request::request(std::shared_ptr<const rfc7541::header_template> tmpl, std::string_view path, http2::method m)
+    : header_tmpl(std::move(tmpl)) {
+  if (!header_tmpl || header_tmpl->find(":scheme") == nullptr || header_tmpl->find(":authority") == nullptr) {
+    throw std::invalid_argument("A template must have scheme and authority");
+  }
+
+  if (path.empty()) {
+    throw std::invalid_argument("Empty path");
+  }
+
+  header({":method", to_string(m)});
+  header({":path", path});
+}
+
 request::request(request &&rhs)
-    : header_list(std::move(rhs.header_list)), body_list(std::move(rhs.body_list)), span_list(std::move(rhs.span_list)),
-      size(rhs.size), timeout_value(rhs.timeout_value) {
+    : header_list(std::move(rhs.header_list)), header_tmpl(std::move(rhs.header_tmpl)),
+      committed_headers(rhs.committed_headers), body_list(std::move(rhs.body_list)),
+      span_list(std::move(rhs.span_list)), size(rhs.size), timeout_value(rhs.timeout_value),
+      header_filter(std::move(rhs.header_filter)) {
   rhs.size = 0;
+  rhs.committed_headers = 0;
 }
 
 request &request::operator=(request &&rhs) {
   header_list = std::move(rhs.header_list);
+  header_tmpl = std::move(rhs.header_tmpl);
+  committed_headers = rhs.committed_headers;
   body_list = std::move(rhs.body_list);
   span_list = std::move(rhs.span_list);
   size = rhs.size;
   timeout_value = rhs.timeout_value;
+  header_filter = std::move(rhs.header_filter);
 
   rhs.size = 0;
+  rhs.committed_headers = 0;
   return *this;
 }
 
@@ -60,6 +81,11 @@ request &request::headers(std::initializer_list<rfc7541::header_field> fields) {
   return *this;
 }
 
+request &request::response_header_filter(std::function<bool(std::string_view)> &&filter) {
+  header_filter = std::move(filter);
+  return *this;
+}
+
 request &request::body(std::vector<uint8_t> &&buffer) {
   body_list.emplace_back(std::move(buffer));
   const auto &b = std::get<std::vector<uint8_t>>(body_list.back());
@@ -77,12 +103,6 @@ request &request::body(std::string &&str) {
   return *this;
 }
 
-void request::commit_headers(std::size_t n) {
-  while (n--) {
-    header_list.pop_front();
-  };
-}
-
 void request::commit_body(std::size_t n) {
   while (n--) {
     body_list.pop_front();
@@ -2,14 +2,18 @@
 
 #include <chrono>
 #include <deque>
+#include <functional>
 #include <initializer_list>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 #include <boost/url.hpp>
 
 #include "hpack/header_field.h"
+#include "hpack/header_template.h"
 #include "method.h"
 
 namespace http2 {
@@ -32,6 +36,12 @@ using namespace std::chrono_literals;
  * @note All these methods add header fields with no checks. So be carefull since
  * can be added extra pseudo-headers, duplicated fields etc.
  *
+ * Fields those are the same for many requests can be shared via 'rfc7541::header_template'.
+ * Template fields are encoded once, so such requests are cheaper to create and to send.
+ *
+ * Response header fields can be filtered by 'response_header_filter'. Not accepted fields are
+ * skipped by the HPACK decoder with no copying.
+ *
  * A request body can be set as a sequence of slices. Where every slice can be 'std::vector<uint8_t>'
  * or 'std::string'. All slices independ of them types are stored in the order of additional.
  */
@@ -53,6 +63,17 @@ public:
    */
   request(const boost::url &url, http2::method m = http2::method::GET);
 
+  /**
+   * @brief request creates a request by a shared header template.
+   * Template fields are sent before (pseudo-headers) and after (regular headers) own request fields.
+   * @param tmpl is a template that must have ':scheme' and ':authority' pseudo-headers.
+   * Otherwise an exception invalid_argument will thrown.
+   * @param path is an encoded path with a query
+   * @param m is a http2::method
+   */
+  request(std::shared_ptr<const rfc7541::header_template> tmpl, std::string_view path,
+          http2::method m = http2::method::GET);
+
   request(const request &) = delete;
   request &operator=(const request &) = delete;
   request(request &&);
@@ -115,6 +136,15 @@ public:
     return *this;
   }
 
+  /**
+   * @brief response_header_filter sets a filter of response header fields by names.
+   * Fields not accepted by the filter are skipped while decoding and they are never stored in a response.
+   * ':status' is always stored.
+   * @param filter returns true for a field name that should be stored
+   * @return returns a refernce on the request instance so creation can be organised as a chain
+   */
+  request &response_header_filter(std::function<bool(std::string_view)> &&filter);
+
   /**
    * @brief set_timeout set request timeout
    * I. e. a max time which client wait for a response when a request has been sent.
@@ -125,10 +155,16 @@ public:
 
   /**
    * @brief raw_headers
-   * @return  returns a const ref std::deque of all stored  header fields
+   * @return  returns a const ref std::deque of all stored  header fields. Template fields are not included
    */
   [[nodiscard]] const std::deque<rfc7541::header_field> &raw_headers() const noexcept { return header_list; };
 
+  /**
+   * @brief headers_template
+   * @return returns a shared header template or nullptr
+   */
+  [[nodiscard]] const rfc7541::header_template *headers_template() const noexcept { return header_tmpl.get(); }
+
   /**
    * @brief raw_body
    * @return returns a const ref deque of spans for all stored body slices
@@ -149,11 +185,18 @@ public:
 
 private:
   // calling from stream
-  void commit_headers(std::size_t n);
+  void commit_headers(std::size_t n) noexcept { committed_headers += n; }
+  std::size_t headers_count() const noexcept {
+    return header_list.size() + (header_tmpl ? header_tmpl->size() : 0);
+  }
+  bool has_pending_headers() const noexcept { return committed_headers < headers_count(); }
   void commit_body(std::size_t n);
 
 private:
   std::deque<rfc7541::header_field> header_list;
+  std::shared_ptr<const rfc7541::header_template> header_tmpl;
+  // Sent fields. The order is template pseudo-headers, own fields, template regular headers
+  std::size_t committed_headers = 0;
 
   using block_type = std::variant</*std::monostate, */ std::string, std::vector<uint8_t>>;
   std::deque<block_type> body_list;
@@ -161,6 +204,7 @@ private:
   std::size_t size = 0;
 
   std::chrono::milliseconds timeout_value = 30s;
+  std::function<bool(std::string_view)> header_filter;
 
   friend stream;
 };
@@ -1,27 +1,52 @@
 #include "response.h"
 
 #include <algorithm>
+#include <charconv>
 
 #include "frame.h"
 #include "protocol.h"
 
 namespace http2 {
 
-void response::insert_headers(rfc7541::header &&header) {
-  std::move(header.begin(), header.end(), std::back_inserter(header_list));
-  if (status_view.empty()) {
-    if (auto it = std::find_if(header_list.begin(), header_list.end(),
-                               [](const auto &hf) { return hf.name_view() == ":status"; });
-        it != header_list.end()) {
-      status_view = it->value_view();
+namespace {
+template <typename T> std::optional<T> parse_number(std::string_view str) {
+  T value{};
+  auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc{} || end != str.data() + str.size() || str.empty()) {
+    return std::nullopt;
+  }
+  return value;
+}
+} // namespace
+
+void response::insert_header(const rfc7541::header_field_view &field) {
+  const auto &hf = header_list.emplace_back(field);
+  auto name = hf.name_atom();
+  if (name == rfc7541::atoms::none) {
+    return;
+  }
+  if (name >= atom_positions.size()) {
+    atom_positions.resize(std::max<std::size_t>(name + 1, rfc7541::atoms::first_extra));
+  }
+  if (atom_positions[name] == 0) {
+    atom_positions[name] = static_cast<uint32_t>(header_list.size());
+    if (name == rfc7541::atoms::status) {
+      status_view = hf.value_view();
     }
   }
 }
 
-void response::insert_body(utils::buffer &&b) {
-  const auto analyzer = frame_analyzer::from_buffer(b.data_view());
+std::optional<unsigned> response::status_code() const { return parse_number<unsigned>(status_view); }
+
+std::optional<std::size_t> response::content_length() const {
+  const auto *field = find(rfc7541::atoms::content_length);
+  return field ? parse_number<std::size_t>(field->value_view()) : std::nullopt;
+}
+
+void response::insert_body(utils::buffer_slice &&frame) {
+  const auto analyzer = frame_analyzer::from_buffer(frame.data_view());
   auto span = analyzer.template get_frame<frame_type::DATA>().data();
-  body_blocks.emplace_back(std::move(b), span);
+  body_blocks.emplace_back(std::move(frame), span);
   size += span.size_bytes();
 }
 
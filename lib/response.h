@@ -1,11 +1,13 @@
 #pragma once
 
 #include <deque>
+#include <optional>
 #include <ranges>
 #include <span>
+#include <vector>
 
 #include "hpack/header_field.h"
-#include "utils/buffer.h"
+#include "utils/buffer_slice.h"
 
 namespace http2 {
 
@@ -23,6 +25,27 @@ public:
   std::string_view status() const { return status_view; }
   const std::deque<rfc7541::header_field> &headers() const { return header_list; };
 
+  /**
+   * @brief find looks up a header field by an atom of its name with no string comparisons.
+   * @return the first field with the name or nullptr. @see base_client::register_header_atom
+   */
+  const rfc7541::header_field *find(rfc7541::atom name) const noexcept {
+    return name < atom_positions.size() && atom_positions[name] != 0 ? &header_list[atom_positions[name] - 1]
+                                                                     : nullptr;
+  }
+
+  /**
+   * @brief status_code
+   * @return a parsed ':status' or nullopt when it is missing or invalid
+   */
+  std::optional<unsigned> status_code() const;
+
+  /**
+   * @brief content_length
+   * @return a parsed 'content-length' or nullopt when it is missing or invalid
+   */
+  std::optional<std::size_t> content_length() const;
+
   std::size_t body_size() const { return size; }
 
   auto body_range() const {
@@ -37,16 +60,19 @@ public:
   }
 
 private:
-  void insert_headers(rfc7541::header &&header);
-  void insert_body(utils::buffer &&);
+  void insert_header(const rfc7541::header_field_view &field);
+  void insert_body(utils::buffer_slice &&);
   std::size_t copy_body(char *dst, std::size_t len) const;
 
 private:
   std::deque<rfc7541::header_field> header_list;
   mutable std::string_view status_view;
+  // 1-based positions in 'header_list' of the first fields by atoms
+  std::vector<uint32_t> atom_positions;
 
   struct body_block {
-    utils::buffer buffer;
+    // A DATA frame that shares a read buffer with other received frames
+    utils::buffer_slice frame;
     std::span<const uint8_t> span;
   };
 
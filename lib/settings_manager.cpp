@@ -52,9 +52,7 @@ utils::buffer settings_manager::initiate_sync_settings(
   });
 }
 
-std::optional<utils::buffer> settings_manager::on_settings_frame(std::span<const uint8_t> data) {
-  const auto analyzer = frame_analyzer::from_buffer(data);
-  const auto &frame = analyzer.get_frame<frame_type::SETTINGS>();
+std::optional<utils::buffer> settings_manager::on_settings_frame(const settings_frame &frame) {
   if (frame.flags & flags::ACK) {
     local_settings_ack = true;
   } else {
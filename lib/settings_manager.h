@@ -10,6 +10,9 @@
 #include "utils/buffer.h"
 
 namespace http2 {
+
+struct settings_frame;
+
 class settings_manager {
 public:
   explicit settings_manager(boost::asio::io_context &context);
@@ -24,7 +27,7 @@ public:
                                        boost::asio::any_completion_handler<void(boost::system::error_code)> &&);
   bool cancel(const boost::system::error_code &ec);
 
-  std::optional<utils::buffer> on_settings_frame(std::span<const uint8_t>);
+  std::optional<utils::buffer> on_settings_frame(const settings_frame &frame);
 
 private:
   bool finished(const boost::system::error_code &ec);
@@ -1,6 +1,8 @@
 #include "stream.h"
 
+#include <cstring>
 #include <ranges>
+#include <vector>
 
 #include <boost/url.hpp>
 
@@ -18,7 +20,7 @@ stream::stream(boost::asio::io_context &io, boost::endian::big_uint32_t id, std:
 stream::~stream() = default;
 
 bool stream::has_tx_data() const {
-  return http_state == HttpState::HALF_CLOSED || local_window.need_update() || !m_request.header_list.empty() ||
+  return http_state == HttpState::HALF_CLOSED || local_window.need_update() || m_request.has_pending_headers() ||
          !m_request.body_list.empty();
 }
 
@@ -36,13 +38,13 @@ void stream::reset(const boost::system::error_code &ec) {
   finished(ec);
 }
 
-void stream::on_receive_data(utils::buffer &&buff) {
-  local_window.dec(buff.data_view().size_bytes());
-  const auto analyzer = frame_analyzer::from_buffer(buff.data_view());
+void stream::on_receive_data(utils::buffer_slice &&frame) {
+  local_window.dec(frame.data_view().size_bytes());
+  const auto analyzer = frame_analyzer::from_buffer(frame.data_view());
   const auto &header = analyzer.frame_header();
 
   if (header.payload_size() != 0) {
-    m_response.insert_body(std::move(buff));
+    m_response.insert_body(std::move(frame));
   }
   if (header.flags & flags::END_STREAM) {
     http_state = HttpState::HALF_CLOSED;
@@ -51,14 +53,13 @@ void stream::on_receive_data(utils::buffer &&buff) {
   }
 }
 
-void stream::on_receive_headers(rfc7541::header &&header, uint8_t flags, std::size_t raw_size) {
+void stream::on_receive_headers(uint8_t flags, std::size_t raw_size) {
   local_window.dec(raw_size);
-  m_response.insert_headers(std::move(header));
 
-  if (flags & flags::END_STREAM) {
-    http_state = HttpState::HALF_CLOSED;
-    timer.cancel();
-    finished(boost::system::error_code{});
+  // END_STREAM is applied after the whole header block is received
+  remote_end_stream = (flags & flags::END_STREAM) != 0;
+  if (flags & flags::END_HEADERS) {
+    on_end_headers();
   }
 }
 
@@ -71,11 +72,24 @@ void stream::on_receive_window_update(uint32_t increment) {
   remote_window += increment;
 }
 
-void stream::on_receive_continuation(rfc7541::header &&header, uint8_t flags, std::size_t raw_size) {
+void stream::on_receive_continuation(uint8_t flags, std::size_t raw_size) {
   local_window.dec(raw_size);
-  m_response.insert_headers(std::move(header));
 
-  if (flags & flags::END_STREAM) {
+  if (flags & flags::END_HEADERS) {
+    on_end_headers();
+  }
+}
+
+bool stream::accept(std::string_view name) {
+  return !m_request.header_filter || name == ":status" || m_request.header_filter(name);
+}
+
+void stream::on_field(const rfc7541::header_field_view &field) { m_response.insert_header(field); }
+
+void stream::on_end_headers() {
+  if (remote_end_stream) {
+    http_state = HttpState::HALF_CLOSED;
+    timer.cancel();
     finished(boost::system::error_code{});
   }
 }
@@ -83,34 +97,42 @@ void stream::on_receive_continuation(rfc7541::header &&header, uint8_t flags, st
 std::size_t stream::prepare_headers(std::deque<utils::buffer> &out, rfc7541::encoder &encoder, std::size_t limit) {
   std::size_t used = 0;
   auto &rq = get_request();
-  auto &headers = rq.raw_headers();
 
-  auto [buffers, count] =
-      encoder.encode(headers, is_cointinuation ? limit - 2 * sizeof(header) : limit - sizeof(header));
+  // Template pseudo-headers, own fields, template regular headers
+  std::vector<rfc7541::encoder::field_ref> fields;
+  fields.reserve(rq.headers_count());
+  auto add_template = [&fields](auto entries) {
+    for (const auto &e : entries) {
+      fields.push_back({&e.field, e.encoded});
+    }
+  };
+  if (rq.header_tmpl) {
+    add_template(rq.header_tmpl->pseudo_headers());
+  }
+  for (const auto &f : rq.header_list) {
+    fields.push_back({&f, {}});
+  }
+  if (rq.header_tmpl) {
+    add_template(rq.header_tmpl->regular_headers());
+  }
+
+  auto pending = std::span<const rfc7541::encoder::field_ref>(fields).subspan(rq.committed_headers);
+  auto max_payload = is_cointinuation ? limit - 2 * sizeof(header) : limit - sizeof(header);
+  auto [frame, frame_header] =
+      frame_builder::header_block(is_cointinuation ? frame_type::CONTINUATION : frame_type::HEADERS, id(),
+                                  std::min(max_payload, encoder.size_hint(pending)));
+  auto count = encoder.encode(pending, frame);
   if (count == 0) {
     return used;
   }
 
   rq.commit_headers(count);
+  bool headers_sent = !rq.has_pending_headers();
 
-  // TODO: have a size inside buffers
-  std::size_t buffer_size = 0;
-  for (const auto &b : buffers) {
-    buffer_size += b.data_view().size_bytes();
-  }
-
-  uint8_t flags = headers.empty() ? flags::END_HEADERS : 0;
-
-  if (is_cointinuation) {
-    auto frame_header = frame_builder::continuation(id(), flags, buffer_size);
-    used += frame_header.data_view().size_bytes();
-    out.emplace_back(std::move(frame_header));
-  } else {
+  uint8_t flags = headers_sent ? flags::END_HEADERS : 0;
+  if (!is_cointinuation) {
     flags = rq.body_list.empty() ? flags | flags::END_STREAM : flags;
-    auto frame_header = frame_builder::headers(id(), flags, buffer_size);
-    used += frame_header.data_view().size_bytes();
-    out.emplace_back(std::move(frame_header));
-    is_cointinuation = !headers.empty();
+    is_cointinuation = !headers_sent;
     timer.expires_after(m_request.timeout());
     timer.async_wait([this](const auto &ec) {
       if (ec != boost::asio::error::operation_aborted) {
@@ -118,45 +140,48 @@ std::size_t stream::prepare_headers(std::deque<utils::buffer> &out, rfc7541::enc
       }
     });
   }
+  frame_header->flags = flags;
+  frame_header->set_payload_size(frame.data_view().size_bytes() - sizeof(header));
 
-  used += buffer_size;
-  std::move(buffers.begin(), buffers.end(), std::back_inserter(out));
+  used += frame.data_view().size_bytes();
+  out.emplace_back(std::move(frame));
 
-  if (is_cointinuation && headers.empty() && rq.body_list.empty()) {
-    auto [frame_header, payload] = frame_builder::data(id(), flags::END_STREAM, 0);
-    out.emplace_back(std::move(frame_header));
-    used += frame_header.data_view().size_bytes();
+  if (is_cointinuation && headers_sent && rq.body_list.empty()) {
+    auto [last_frame, payload] = frame_builder::data(id(), flags::END_STREAM, 0);
+    used += last_frame.data_view().size_bytes();
+    out.emplace_back(std::move(last_frame));
   }
 
   return used;
 }
 
 std::size_t stream::prepare_body(std::deque<utils::buffer> &out, std::size_t limit) {
-  auto left_size = m_request.body_size() - send_body_offset;
+  auto left_size = m_request.body_size() - sent_body_size;
   auto payload_size = std::min(limit - sizeof(data_frame), left_size);
 
   bool is_last = payload_size == left_size;
-  auto [frame_header, payload] = frame_builder::data(id(), is_last ? flags::END_STREAM : 0, payload_size);
-
-  out.emplace_back(std::move(frame_header));
-
-  auto body_it = m_request.body_list.begin();
-  auto span_it = m_request.span_list.begin();
-  do {
-    auto to_copy = std::min(payload.size_bytes(), span_it->size_bytes() - send_body_offset);
-    memcpy(payload.data(), span_it->data() + send_body_offset, to_copy);
-    send_body_offset += to_copy;
-    if (send_body_offset == span_it->size_bytes()) {
-      send_body_offset = 0;
-      body_it++;
-      span_it++;
-      m_request.body_list.pop_front();
-      m_request.span_list.pop_front();
+  auto [frame, payload] = frame_builder::data(id(), is_last ? flags::END_STREAM : 0, payload_size);
+  sent_body_size += payload_size;
+
+  // A slice is dropped when it is sent completely. Empty slices are dropped on the way
+  while (!m_request.span_list.empty()) {
+    auto slice = m_request.span_list.front().subspan(send_body_offset);
+    auto to_copy = std::min(payload.size_bytes(), slice.size_bytes());
+    if (to_copy != 0) {
+      memcpy(payload.data(), slice.data(), to_copy);
     }
     payload = payload.subspan(to_copy);
-  } while (payload.size_bytes() != 0);
+    if (to_copy != slice.size_bytes()) {
+      send_body_offset += to_copy;
+      break;
+    }
+    send_body_offset = 0;
+    m_request.commit_body(1);
+  }
 
-  return frame_header.data_view().size_bytes();
+  auto used = frame.data_view().size_bytes();
+  out.emplace_back(std::move(frame));
+  return used;
 }
 
 std::size_t stream::get_tx_data(std::deque<utils::buffer> &out, rfc7541::encoder &encoder, std::size_t limit) {
@@ -185,12 +210,11 @@ std::size_t stream::get_tx_data(std::deque<utils::buffer> &out, rfc7541::encoder
   }
 
   auto &rq = get_request();
-  auto &headers = rq.raw_headers();
-  if (!headers.empty()) {
+  if (rq.has_pending_headers()) {
     bytes_used += prepare_headers(out, encoder, limit);
   }
 
-  if (headers.empty() && rq.body_size() != 0 && (limit - bytes_used) >= 2 * sizeof(data_frame)) {
+  if (!rq.has_pending_headers() && !rq.body_list.empty() && (limit - bytes_used) >= 2 * sizeof(data_frame)) {
     bytes_used += prepare_body(out, limit - bytes_used);
   }
   remote_window -= bytes_used;
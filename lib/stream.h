@@ -9,6 +9,7 @@
 
 #include "dummy_window.h"
 #include "error.h"
+#include "hpack/decoder.h"
 #include "request.h"
 #include "response.h"
 #include "utils/buffer.h"
@@ -23,8 +24,9 @@ class base_client;
 
 /**
  * @brief The stream class represents a HTTP2 stream.
+ * It is a sink of decoded response header fields.
  */
-class stream : public boost::intrusive_ref_counter<stream> {
+class stream : public boost::intrusive_ref_counter<stream>, public rfc7541::field_sink {
 public:
   using ptr = boost::intrusive_ptr<stream>;
 
@@ -46,17 +48,23 @@ public:
   void reset(const boost::system::error_code &ec);
 
   // Internal IO
-  void on_receive_data(utils::buffer &&buff);
-  void on_receive_headers(rfc7541::header &&header, uint8_t flags, std::size_t raw_size);
+  void on_receive_data(utils::buffer_slice &&frame);
+  void on_receive_headers(uint8_t flags, std::size_t raw_size);
   void on_receive_reset(error_code err);
   void on_receive_window_update(uint32_t increment);
-  void on_receive_continuation(rfc7541::header &&header, uint8_t flags, std::size_t raw_size);
+  void on_receive_continuation(uint8_t flags, std::size_t raw_size);
+
+  // Response header fields
+  bool accept(std::string_view name) override;
+  bool accepts_huffman() const override { return true; }
+  void on_field(const rfc7541::header_field_view &field) override;
 
   std::size_t get_tx_data(std::deque<utils::buffer> &out, rfc7541::encoder &enc, std::size_t limit);
 
 private:
   std::size_t prepare_headers(std::deque<utils::buffer> &out, rfc7541::encoder &enc, std::size_t limit);
   std::size_t prepare_body(std::deque<utils::buffer> &out, std::size_t limit);
+  void on_end_headers();
   void finished(const boost::system::error_code &ec);
 
 private:
@@ -74,7 +82,10 @@ private:
   };
   HttpState http_state = HttpState::IDLE;
   bool is_cointinuation = false;
+  bool remote_end_stream = false;
+  // An offset in the first body slice and a size of sent body
   std::size_t send_body_offset = 0;
+  std::size_t sent_body_size = 0;
 
   request m_request;
   response m_response;
@@ -5,6 +5,8 @@
 #include <memory>
 #include <span>
 
+#include "memory_resource.h"
+
 namespace utils {
 
 /**
@@ -13,27 +15,46 @@ namespace utils {
  * After the creation the buffer is empty and ready to save a data.
  * A data producer sholuld use methods - 'prepare' and 'commit'
  * A data consumer should use methods - 'data_view' and 'consume'
+ * Data is written at the write cursor and consumed from the read cursor. So consuming doesn't move data.
+ * The consumed room is reused when all data is consumed or after 'compact'.
  * @note technically is possible to create a buffer with 0 bytes size. No exception thrown in this case.
  */
 class buffer {
 public:
   buffer(const buffer &) = delete;
   buffer &operator=(const buffer &) = delete;
-  ~buffer() = default;
+  ~buffer() { release(); }
 
-  explicit buffer(std::size_t size) : offset(0), maxsize(size), memory(new uint8_t[maxsize]) {}
+  /**
+   * @param size is a buffer size
+   * @param resource allocates the buffer memory. @see default_buffer_resource
+   */
+  explicit buffer(std::size_t size, std::pmr::memory_resource *resource = default_buffer_resource())
+      : maxsize(size), memory(size != 0 ? static_cast<uint8_t *>(resource->allocate(size)) : nullptr),
+        mem_resource(resource) {}
 
-  buffer(buffer &&rhs) : offset(rhs.offset), maxsize(rhs.maxsize), memory(std::move(rhs.memory)) {
+  buffer(buffer &&rhs) noexcept
+      : read_offset(rhs.read_offset), offset(rhs.offset), maxsize(rhs.maxsize), memory(rhs.memory),
+        mem_resource(rhs.mem_resource) {
     rhs.maxsize = 0;
+    rhs.read_offset = 0;
     rhs.offset = 0;
+    rhs.memory = nullptr;
   };
 
-  buffer &operator=(buffer &&rhs) {
-    memory = std::move(rhs.memory);
-    maxsize = rhs.maxsize;
-    offset = rhs.offset;
-    rhs.maxsize = 0;
-    rhs.offset = 0;
+  buffer &operator=(buffer &&rhs) noexcept {
+    if (this != &rhs) {
+      release();
+      memory = rhs.memory;
+      mem_resource = rhs.mem_resource;
+      maxsize = rhs.maxsize;
+      read_offset = rhs.read_offset;
+      offset = rhs.offset;
+      rhs.memory = nullptr;
+      rhs.maxsize = 0;
+      rhs.read_offset = 0;
+      rhs.offset = 0;
+    }
     return *this;
   };
 
@@ -43,7 +64,7 @@ public:
    * data.
    */
   std::span<uint8_t> prepare() noexcept {
-    return {memory.get() + offset, maxsize - offset};
+    return {memory + offset, maxsize - offset};
   };
 
   /**
@@ -69,7 +90,7 @@ public:
    */
   std::size_t commit(std::span<const uint8_t> span) noexcept {
     auto to_copy = std::min(prepare().size_bytes(), span.size_bytes());
-    memcpy(memory.get() + offset, span.data(), to_copy);
+    memcpy(memory + offset, span.data(), to_copy);
     offset += to_copy;
     return to_copy;
   }
@@ -78,21 +99,31 @@ public:
    * @brief data_view should be called by data consumer for retrieving of stored data
    * @return return a span of constant bytes those has bin written.
    */
-  std::span<const uint8_t> data_view() const noexcept { return {memory.get(), offset}; }
+  std::span<const uint8_t> data_view() const noexcept { return {memory + read_offset, offset - read_offset}; }
 
   /**
    * @brief consume is an auxilary method for consumer.
-   * Actually it removes 'count' of the first written bytes.
-   * @note usually it is slow since uses memmove for the overlapped regions of memory.
-   * So don' recomend to use it everywhere!
+   * Actually it removes 'count' of the first written bytes by moving the read cursor.
+   * When all data is consumed the whole buffer is ready for writing again.
    * @param count - is a bytes count that should be removed.
    */
   void consume(std::size_t count) noexcept {
-    count = std::min(offset, count);
-    if (count != 0 && count < offset) {
-      memmove(memory.get(), memory.get() + count, offset - count);
+    read_offset += std::min(offset - read_offset, count);
+    if (read_offset == offset) {
+      read_offset = offset = 0;
+    }
+  }
+
+  /**
+   * @brief compact moves not consumed data to the buffer beginning. So 'prepare' returns all free room.
+   * @note it uses memmove. So should be called only when the room after data is not enough
+   */
+  void compact() noexcept {
+    if (read_offset != 0) {
+      memmove(memory, memory + read_offset, offset - read_offset);
+      offset -= read_offset;
+      read_offset = 0;
     }
-    offset -= count;
   }
 
   /**
@@ -102,9 +133,19 @@ public:
   std::size_t max_size() const noexcept { return maxsize; }
 
 private:
+  void release() noexcept {
+    if (memory != nullptr) {
+      mem_resource->deallocate(memory, maxsize);
+    }
+  }
+
+private:
+  // Read and write cursors
+  std::size_t read_offset = 0;
   std::size_t offset = 0;
   std::size_t maxsize = 0;
-  std::unique_ptr<uint8_t[]> memory;
+  uint8_t *memory = nullptr;
+  std::pmr::memory_resource *mem_resource = nullptr;
 };
 
 } // namespace utils
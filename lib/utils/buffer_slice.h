@@ -0,0 +1,44 @@
+#pragma once
+
+#include <memory>
+#include <span>
+
+#include "buffer.h"
+
+namespace utils {
+
+/**
+ * @brief The buffer_slice class is a read only part of a shared buffer (a slab).
+ * Many slices can point into one slab. The slab is released with the last slice.
+ * So received frames are kept without copying when one read contains several of them.
+ * @note a slice keeps the whole slab alive. Even when the slice is small.
+ */
+class buffer_slice {
+public:
+  buffer_slice() = default;
+  buffer_slice(const buffer_slice &) = delete;
+  buffer_slice &operator=(const buffer_slice &) = delete;
+  buffer_slice(buffer_slice &&) = default;
+  buffer_slice &operator=(buffer_slice &&) = default;
+  ~buffer_slice() = default;
+
+  /**
+   * @brief buffer_slice
+   * @param s is a slab that holds the memory
+   * @param data must point into the data of 's'
+   */
+  buffer_slice(std::shared_ptr<const buffer> s, std::span<const uint8_t> data) : slab(std::move(s)), view(data) {}
+
+  /**
+   * @brief buffer_slice makes a slab of a whole buffer
+   */
+  explicit buffer_slice(buffer &&b) : slab(std::make_shared<const buffer>(std::move(b))), view(slab->data_view()) {}
+
+  std::span<const uint8_t> data_view() const noexcept { return view; }
+
+private:
+  std::shared_ptr<const buffer> slab;
+  std::span<const uint8_t> view;
+};
+
+} // namespace utils
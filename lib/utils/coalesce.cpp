@@ -0,0 +1,41 @@
+#include "coalesce.h"
+
+#include <iterator>
+
+namespace utils {
+
+std::deque<buffer> coalesce(std::deque<buffer> &&buffers, std::size_t chunk_size, std::size_t min_separate_size) {
+  auto is_small = [min_separate_size](const buffer &b) { return b.data_view().size_bytes() < min_separate_size; };
+
+  std::deque<buffer> result;
+  auto it = buffers.begin();
+  while (it != buffers.end()) {
+    if (!is_small(*it)) {
+      result.emplace_back(std::move(*it++));
+      continue;
+    }
+
+    // A run of small buffers those fit into one chunk
+    auto run_end = it;
+    std::size_t run_size = 0;
+    while (run_end != buffers.end() && is_small(*run_end) &&
+           (run_size == 0 || run_size + run_end->data_view().size_bytes() <= chunk_size)) {
+      run_size += run_end->data_view().size_bytes();
+      ++run_end;
+    }
+
+    if (std::next(it) == run_end) {
+      result.emplace_back(std::move(*it++));
+      continue;
+    }
+
+    buffer chunk(run_size);
+    for (; it != run_end; ++it) {
+      chunk.commit(it->data_view());
+    }
+    result.emplace_back(std::move(chunk));
+  }
+  return result;
+}
+
+} // namespace utils
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <deque>
+
+#include "buffer.h"
+
+namespace utils {
+
+/**
+ * @brief coalesce copies runs of small buffers into contiguous chunks of up to 'chunk_size' bytes.
+ * Buffers of 'min_separate_size' bytes or more and a small buffer that has no small neighbours are moved as is.
+ * The order of data is kept. So a transport gets fewer and bigger buffers, e.g. full TLS records.
+ * @param buffers is a data for sending
+ * @param chunk_size is a max size of a chunk
+ * @param min_separate_size is a size of buffers those are not copied
+ * @return buffers with the same data
+ */
+std::deque<buffer> coalesce(std::deque<buffer> &&buffers, std::size_t chunk_size, std::size_t min_separate_size);
+
+} // namespace utils
@@ -0,0 +1,251 @@
+#include "memory_resource.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace utils {
+
+namespace {
+constexpr std::size_t MinBlockSize = pooled_resource::MinBlockSize;
+constexpr std::size_t MaxBlockSize = pooled_resource::MaxBlockSize;
+constexpr std::size_t ClassCount = std::countr_zero(MaxBlockSize) - std::countr_zero(MinBlockSize) + 1;
+constexpr std::size_t BlockAlignment = alignof(std::max_align_t);
+
+// Limits of free blocks of one size class. In bytes and in blocks
+constexpr std::size_t ThreadCacheBytes = 256 * 1024;
+constexpr std::size_t ThreadCacheBlocks = 32;
+constexpr std::size_t SharedListBytes = 4 * 1024 * 1024;
+constexpr std::size_t SharedListBlocks = 1024;
+// Count of resources whose blocks a thread caches at the same time
+constexpr std::size_t ThreadCacheSlots = 4;
+
+constexpr std::size_t class_index(std::size_t bytes) {
+  return bytes <= MinBlockSize ? 0 : std::bit_width(bytes - 1) - std::countr_zero(MinBlockSize);
+}
+
+constexpr std::size_t class_size(std::size_t index) { return MinBlockSize << index; }
+
+constexpr std::size_t class_limit(std::size_t index, std::size_t bytes, std::size_t blocks) {
+  return std::clamp<std::size_t>(bytes / class_size(index), 1, blocks);
+}
+
+static_assert(class_index(MinBlockSize) == 0);
+static_assert(class_index(MinBlockSize + 1) == 1);
+static_assert(class_index(MaxBlockSize) == ClassCount - 1);
+} // namespace
+
+struct pooled_resource::pool_state {
+  explicit pool_state(std::pmr::memory_resource *r) : upstream(r) {
+    // Pushing of a free block never allocates
+    for (std::size_t i = 0; i < ClassCount; ++i) {
+      lists[i].blocks.reserve(class_limit(i, SharedListBytes, SharedListBlocks));
+    }
+  }
+  pool_state(const pool_state &) = delete;
+  pool_state(pool_state &&) = delete;
+  ~pool_state() {
+    for (std::size_t i = 0; i < ClassCount; ++i) {
+      for (auto *p : lists[i].blocks) {
+        free_block(i, p);
+      }
+    }
+  }
+
+  void *new_block(std::size_t index) { return upstream->allocate(class_size(index), BlockAlignment); }
+  void free_block(std::size_t index, void *p) { upstream->deallocate(p, class_size(index), BlockAlignment); }
+
+  void *pop(std::size_t index) {
+    auto &list = lists[index];
+    std::scoped_lock lock(list.mutex);
+    if (list.blocks.empty()) {
+      return nullptr;
+    }
+    auto *p = list.blocks.back();
+    list.blocks.pop_back();
+    return p;
+  }
+
+  bool push(std::size_t index, void *p) {
+    auto &list = lists[index];
+    std::scoped_lock lock(list.mutex);
+    if (list.blocks.size() == list.blocks.capacity()) {
+      return false;
+    }
+    list.blocks.push_back(p);
+    return true;
+  }
+
+  struct free_list {
+    std::mutex mutex;
+    std::vector<void *> blocks;
+  };
+
+  std::pmr::memory_resource *upstream;
+  std::array<free_list, ClassCount> lists;
+
+  std::atomic<uint64_t> hits = 0;
+  std::atomic<uint64_t> misses = 0;
+  std::atomic<uint64_t> unpooled = 0;
+};
+
+namespace {
+using pool_state = pooled_resource::pool_state;
+
+// Free blocks of a thread. A slot keeps a resource state, so blocks are given back when the thread exits
+class thread_cache {
+public:
+  struct slot {
+    std::shared_ptr<pool_state> state;
+    std::array<std::vector<void *>, ClassCount> blocks;
+  };
+
+  thread_cache() = default;
+  thread_cache(const thread_cache &) = delete;
+  thread_cache(thread_cache &&) = delete;
+  ~thread_cache() {
+    for (auto &s : slots) {
+      flush(s);
+    }
+  }
+
+  /**
+   * @brief find returns blocks of the resource state. Binds a slot when the state is used first time.
+   * @return nullptr when the slot can't be allocated
+   */
+  slot *find(const std::shared_ptr<pool_state> &state) noexcept {
+    for (auto &s : slots) {
+      if (s.state == state) {
+        return &s;
+      }
+    }
+
+    auto &s = slots[next_slot];
+    next_slot = (next_slot + 1) % slots.size();
+    flush(s);
+    try {
+      for (std::size_t i = 0; i < ClassCount; ++i) {
+        s.blocks[i].reserve(class_limit(i, ThreadCacheBytes, ThreadCacheBlocks));
+      }
+    } catch (const std::bad_alloc &) {
+      return nullptr;
+    }
+    s.state = state;
+    return &s;
+  }
+
+private:
+  static void flush(slot &s) noexcept {
+    if (!s.state) {
+      return;
+    }
+    for (std::size_t i = 0; i < ClassCount; ++i) {
+      for (auto *p : s.blocks[i]) {
+        if (!s.state->push(i, p)) {
+          s.state->free_block(i, p);
+        }
+      }
+      s.blocks[i].clear();
+    }
+    s.state.reset();
+  }
+
+private:
+  std::array<slot, ThreadCacheSlots> slots;
+  std::size_t next_slot = 0;
+};
+
+// Memory can be released by destructors of other thread local objects after the cache is destroyed
+enum class cache_state : uint8_t { NOT_CREATED, ALIVE, DESTROYED };
+thread_local cache_state local_cache_state = cache_state::NOT_CREATED;
+
+struct local_cache_holder {
+  local_cache_holder() { local_cache_state = cache_state::ALIVE; }
+  local_cache_holder(const local_cache_holder &) = delete;
+  local_cache_holder(local_cache_holder &&) = delete;
+  ~local_cache_holder() { local_cache_state = cache_state::DESTROYED; }
+
+  thread_cache cache;
+};
+
+thread_cache::slot *local_slot(const std::shared_ptr<pool_state> &state) noexcept {
+  if (local_cache_state == cache_state::DESTROYED) {
+    return nullptr;
+  }
+  thread_local local_cache_holder holder;
+  return holder.cache.find(state);
+}
+
+std::atomic<std::pmr::memory_resource *> buffer_resource = nullptr;
+} // namespace
+
+pooled_resource::pooled_resource(std::pmr::memory_resource *upstream)
+    : state(std::make_shared<pool_state>(upstream)) {}
+
+pooled_resource::~pooled_resource() = default;
+
+pooled_resource::statistics pooled_resource::get_statistics() const noexcept {
+  return {state->hits.load(std::memory_order_relaxed), state->misses.load(std::memory_order_relaxed),
+          state->unpooled.load(std::memory_order_relaxed)};
+}
+
+void *pooled_resource::do_allocate(std::size_t bytes, std::size_t alignment) {
+  if (bytes > MaxBlockSize || alignment > BlockAlignment) {
+    state->unpooled.fetch_add(1, std::memory_order_relaxed);
+    return state->upstream->allocate(bytes, alignment);
+  }
+
+  auto index = class_index(bytes);
+  if (auto *slot = local_slot(state); slot && !slot->blocks[index].empty()) {
+    auto *p = slot->blocks[index].back();
+    slot->blocks[index].pop_back();
+    state->hits.fetch_add(1, std::memory_order_relaxed);
+    return p;
+  }
+  if (auto *p = state->pop(index)) {
+    state->hits.fetch_add(1, std::memory_order_relaxed);
+    return p;
+  }
+  state->misses.fetch_add(1, std::memory_order_relaxed);
+  return state->new_block(index);
+}
+
+void pooled_resource::do_deallocate(void *p, std::size_t bytes, std::size_t alignment) {
+  if (bytes > MaxBlockSize || alignment > BlockAlignment) {
+    state->upstream->deallocate(p, bytes, alignment);
+    return;
+  }
+
+  auto index = class_index(bytes);
+  if (auto *slot = local_slot(state);
+      slot && slot->blocks[index].size() < slot->blocks[index].capacity()) {
+    slot->blocks[index].push_back(p);
+    return;
+  }
+  if (!state->push(index, p)) {
+    state->free_block(index, p);
+  }
+}
+
+pooled_resource &default_pooled_resource() noexcept {
+  // Is never destroyed since buffers can be released by destructors of static objects
+  static auto *resource = new pooled_resource();
+  return *resource;
+}
+
+std::pmr::memory_resource *default_buffer_resource() noexcept {
+  auto *resource = buffer_resource.load(std::memory_order_acquire);
+  return resource ? resource : &default_pooled_resource();
+}
+
+std::pmr::memory_resource *set_default_buffer_resource(std::pmr::memory_resource *resource) noexcept {
+  auto *prev = buffer_resource.exchange(resource, std::memory_order_acq_rel);
+  return prev ? prev : &default_pooled_resource();
+}
+
+} // namespace utils
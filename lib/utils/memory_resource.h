@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+
+namespace utils {
+
+/**
+ * @brief The pooled_resource class is a memory resource with size classed free lists.
+ * Sizes are rounded up to powers of 2 from MinBlockSize to MaxBlockSize. Bigger blocks are not pooled.
+ * Every thread has a cache of free blocks, so a steady state allocation doesn't take a lock.
+ * Blocks that don't fit into a thread cache go to shared lists.
+ * The resource can be used from any threads.
+ * @note a thread keeps the resource free blocks in its cache until the thread exits.
+ */
+class pooled_resource final : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t MinBlockSize = 64;
+  static constexpr std::size_t MaxBlockSize = 256 * 1024;
+
+  struct statistics {
+    // Allocations from free lists
+    uint64_t hits = 0;
+    // Allocations of a pooled size from the upstream resource
+    uint64_t misses = 0;
+    // Allocations those are greater than MaxBlockSize
+    uint64_t unpooled = 0;
+  };
+
+  /**
+   * @param upstream is used for allocation of new blocks. It must outlive the pooled_resource.
+   */
+  explicit pooled_resource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+  pooled_resource(const pooled_resource &) = delete;
+  pooled_resource &operator=(const pooled_resource &) = delete;
+  ~pooled_resource() override;
+
+  statistics get_statistics() const noexcept;
+
+  struct pool_state;
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+private:
+  std::shared_ptr<pool_state> state;
+};
+
+/**
+ * @brief default_buffer_resource
+ * @return a resource that is used by 'buffer' by default. It is a process wide pooled_resource
+ * until it is changed by set_default_buffer_resource.
+ */
+std::pmr::memory_resource *default_buffer_resource() noexcept;
+
+/**
+ * @brief set_default_buffer_resource sets a resource for buffers those are created later.
+ * @param resource must outlive all buffers. nullptr sets the process wide pooled_resource
+ * @return the previous resource
+ */
+std::pmr::memory_resource *set_default_buffer_resource(std::pmr::memory_resource *resource) noexcept;
+
+/**
+ * @brief default_pooled_resource
+ * @return the process wide pooled_resource. Its statistics describe all buffers by default.
+ */
+pooled_resource &default_pooled_resource() noexcept;
+
+} // namespace utils
@@ -38,6 +38,14 @@ void streambuf::push_back(std::span<const uint8_t> src) {
   }
 }
 
+std::span<uint8_t> streambuf::prepare(std::size_t size) {
+  if (buffers.empty() || buffers.back().prepare().size_bytes() < size) {
+    auto next_size = buffers.empty() ? MinBufferSize : std::min(buffers.back().max_size() * 2, MaxBufferSize);
+    buffers.push_back(buffer(std::max(align_size(size), next_size)));
+  }
+  return buffers.back().prepare();
+}
+
 std::deque<buffer> streambuf::flush() noexcept {
   std::deque<buffer> ret;
   ret.swap(buffers);
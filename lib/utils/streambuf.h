@@ -28,6 +28,13 @@ public:
    */
   void push_back(std::span<const uint8_t> src);
 
+  /**
+   * @brief prepare returns a contiguous room of at least 'size' bytes at the end of the stream.
+   * Written bytes are stored by 'commit'.
+   */
+  std::span<uint8_t> prepare(std::size_t size);
+  void commit(std::size_t count) noexcept { buffers.back().commit(count); }
+
   /**
    * @brief flush flushes all stored data into std::deque<buffer> and returns it
    * and cleares all internall data;
@@ -2,12 +2,13 @@
 #include <boost/test/unit_test.hpp>
 
 #include <algorithm>
+#include <iterator>
 #include <tuple>
 
-#include <hpack/bitstream.h>
 #include <hpack/constants.h>
 #include <hpack/decoder.h>
 #include <hpack/encoder.h>
+#include <hpack/integer.h>
 
 namespace rfc7541 {
 bool operator==(const std::span<const uint8_t> &lhs, const std::span<const uint8_t> &rhs) noexcept {
@@ -129,6 +130,431 @@ BOOST_AUTO_TEST_CASE(EncodeDecode_with_huffman) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(EncodeDecode_new_names) {
+  rfc7541::decoder decoder;
+  rfc7541::encoder encoder;
+
+  // New names are inserted into the dynamic table and the second request is fully indexed
+  const std::deque<rfc7541::header_field> fields = {
+      {":method", "GET"}, {"x-trace-id", "8f2b1c"}, {"x-custom", "value"}, {"x-trace-id", "8f2b1c"}};
+  for (int i = 0; i < 2; ++i) {
+    const auto [encoded_buf, encoded_fields_count] = encoder.encode(fields, 4096);
+    BOOST_REQUIRE_EQUAL(encoded_fields_count, fields.size());
+    const auto encoded_span = encoded_buf.front().data_view();
+    if (i != 0) {
+      BOOST_CHECK_EQUAL(encoded_span.size(), fields.size());
+    }
+
+    const auto decoded = decoder.decode(encoded_span);
+    BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), fields.begin(), fields.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Encode_into_buffer) {
+  rfc7541::decoder decoder;
+  rfc7541::encoder encoder;
+  constexpr std::size_t reserved = 9;
+
+  for (const auto &test_request : encoded_with_huffman_data) {
+    const auto encoded_data = std::span<const uint8_t>(test_request.encoded_data).subspan(padding_size);
+
+    std::vector<rfc7541::encoder::field_ref> refs;
+    for (const auto &f : test_request.fields) {
+      refs.push_back({&f, {}});
+    }
+
+    // The same bytes as the chain of buffers follow the reserved room
+    utils::buffer frame(reserved + encoder.size_hint(refs));
+    frame.commit(reserved);
+    BOOST_CHECK_EQUAL(encoder.encode(refs, frame), test_request.fields.size());
+    const auto encoded_span = frame.data_view().subspan(reserved);
+    BOOST_CHECK_EQUAL_COLLECTIONS(encoded_span.begin(), encoded_span.end(), encoded_data.begin(), encoded_data.end());
+
+    const auto decoded = decoder.decode(encoded_span);
+    BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), test_request.fields.begin(),
+                                  test_request.fields.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Encode_into_small_buffer) {
+  rfc7541::encoder encoder;
+  const std::deque<rfc7541::header_field> fields = {{":method", "GET"}, {"x-custom", "value"}};
+  std::vector<rfc7541::encoder::field_ref> refs;
+  for (const auto &f : fields) {
+    refs.push_back({&f, {}});
+  }
+
+  // Only the first field fits. A field that doesn't fit isn't written at all
+  utils::buffer frame(4);
+  BOOST_CHECK_EQUAL(encoder.encode(refs, frame), 1);
+  BOOST_CHECK_EQUAL(frame.data_view().size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(Encode_with_huffman_cache) {
+  const std::string token = "Bearer " + std::string(200, 'x');
+  const std::deque<rfc7541::header_field> fields = {
+      {":method", "GET"},
+      {"authorization", token, rfc7541::index_type::NEVER_INDEX},
+      {"x-trace", std::string(80, '1'), rfc7541::index_type::WITHOUT_INDEX},
+      {"x-custom", std::string(80, '2')}};
+
+  auto cache = std::make_shared<rfc7541::huffman_cache>(1 << 16);
+  rfc7541::encoder::encoder_config config;
+  config.string_cache = cache;
+  rfc7541::encoder cached_encoder(config);
+  rfc7541::encoder other_encoder(config);
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+
+  auto join = [](const std::deque<utils::buffer> &buffers) {
+    std::vector<uint8_t> data;
+    for (const auto &b : buffers) {
+      data.insert(data.end(), b.data_view().begin(), b.data_view().end());
+    }
+    return data;
+  };
+
+  for (int i = 0; i < 2; ++i) {
+    auto [expected_buffers, expected_count] = encoder.encode(fields, 4096);
+    const auto expected = join(expected_buffers);
+    for (auto *enc : {&cached_encoder, &other_encoder}) {
+      auto [buffers, count] = enc->encode(fields, 4096);
+      const auto data = join(buffers);
+      BOOST_CHECK_EQUAL(count, expected_count);
+      BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), expected.begin(), expected.end());
+    }
+    const auto decoded = decoder.decode(expected);
+    BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), fields.begin(), fields.end());
+  }
+
+  // Only values that are not inserted into the dynamic table are cached
+  BOOST_CHECK_EQUAL(cache->count(), 2);
+  BOOST_CHECK(cache->get({reinterpret_cast<const uint8_t *>(token.data()), token.size()})->is_sensitive());
+}
+
+BOOST_AUTO_TEST_CASE(Encode_table_size_update) {
+  rfc7541::decoder decoder(1 << 16);
+  rfc7541::encoder encoder;
+  const std::deque<rfc7541::header_field> fields = {{":method", "GET"}, {"x-custom", "value"}};
+
+  // Grows up to max_table_size
+  encoder.set_table_size_limit(1 << 20);
+  BOOST_CHECK_EQUAL(encoder.table_size(), 4096);
+  auto [buffers, count] = encoder.encode(fields, 4096);
+  BOOST_REQUIRE_EQUAL(count, fields.size());
+  BOOST_CHECK_EQUAL(encoder.table_size(), encoder.get_config().max_table_size);
+  auto encoded = buffers.front().data_view();
+  BOOST_CHECK_EQUAL(encoded[0] & 0xe0, 0x20);
+  auto decoded = decoder.decode(encoded);
+  BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), fields.begin(), fields.end());
+
+  // Is signaled once
+  std::tie(buffers, count) = encoder.encode(fields, 4096);
+  encoded = buffers.front().data_view();
+  BOOST_CHECK_EQUAL(encoded.size(), fields.size());
+  decoded = decoder.decode(encoded);
+  BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), fields.begin(), fields.end());
+
+  // The smallest size is signaled first. Entries are evicted on both sides
+  encoder.set_table_size_limit(0);
+  encoder.set_table_size_limit(4096);
+  std::tie(buffers, count) = encoder.encode(fields, 4096);
+  encoded = buffers.front().data_view();
+  BOOST_REQUIRE_GT(encoded.size(), 3);
+  BOOST_CHECK_EQUAL(encoded[0], 0x20);
+  BOOST_CHECK_EQUAL(encoded[1] & 0xe0, 0x20);
+  BOOST_CHECK_GT(encoded.size(), fields.size() + 4);
+  decoded = decoder.decode(encoded);
+  BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), fields.begin(), fields.end());
+  BOOST_CHECK_EQUAL(encoder.table_size(), 4096);
+}
+
+BOOST_AUTO_TEST_CASE(Size_hint_with_table_size_update) {
+  rfc7541::encoder encoder;
+  const std::deque<rfc7541::header_field> fields = {{":method", "GET"}, {"x-custom", "value"}};
+  std::vector<rfc7541::encoder::field_ref> refs;
+  for (const auto &f : fields) {
+    refs.push_back({&f, {}});
+  }
+
+  // Two size updates and all fields fit into a buffer of the hinted size
+  auto no_update_hint = encoder.size_hint(refs);
+  encoder.set_table_size_limit(0);
+  encoder.set_table_size_limit(1 << 20);
+  BOOST_CHECK_GT(encoder.size_hint(refs), no_update_hint);
+  utils::buffer frame(encoder.size_hint(refs));
+  BOOST_CHECK_EQUAL(encoder.encode(refs, frame), fields.size());
+  BOOST_CHECK_EQUAL(encoder.size_hint(refs), no_update_hint);
+}
+
+BOOST_AUTO_TEST_CASE(Encode_table_size_update_between_blocks) {
+  rfc7541::encoder encoder;
+  const std::deque<rfc7541::header_field> fields = {{":method", "GET"}, {":path", "/"}};
+
+  // The first field opens a header block
+  auto [buffers, count] = encoder.encode(fields, 1);
+  BOOST_REQUIRE_EQUAL(count, 1);
+
+  // No size update inside of the header block
+  encoder.set_table_size_limit(8192);
+  std::tie(buffers, count) = encoder.encode(std::deque<rfc7541::header_field>(fields.begin() + 1, fields.end()), 4096);
+  BOOST_REQUIRE_EQUAL(count, 1);
+  BOOST_CHECK_EQUAL(buffers.front().data_view().size(), 1);
+  BOOST_CHECK_EQUAL(encoder.table_size(), 4096);
+
+  // The next block starts with the update
+  std::tie(buffers, count) = encoder.encode(fields, 4096);
+  BOOST_REQUIRE_EQUAL(count, fields.size());
+  BOOST_CHECK_EQUAL(buffers.front().data_view()[0] & 0xe0, 0x20);
+  BOOST_CHECK_EQUAL(encoder.table_size(), 8192);
+}
+
+BOOST_AUTO_TEST_CASE(Decode_table_size_update) {
+  // Size updates: 4096 and 8192
+  const std::vector<uint8_t> update_4k = {0x3f, 0xe1, 0x1f};
+  const std::vector<uint8_t> update_8k = {0x3f, 0xe1, 0x3f};
+  const std::vector<uint8_t> method_get = {0x82};
+
+  rfc7541::decoder decoder;
+  BOOST_CHECK_EQUAL(decoder.table_size(), 4096);
+  BOOST_CHECK_THROW(decoder.decode(update_8k), std::invalid_argument);
+
+  decoder.set_max_table_size(8192);
+  BOOST_CHECK_NO_THROW(decoder.decode(update_8k));
+  BOOST_CHECK_EQUAL(decoder.table_size(), 8192);
+
+  // A lower limit requires an update before the next field
+  decoder.set_max_table_size(4096);
+  BOOST_CHECK_THROW(decoder.decode(method_get), std::invalid_argument);
+
+  rfc7541::decoder lowered(8192);
+  lowered.decode(update_8k);
+  lowered.set_max_table_size(4096);
+  std::vector<uint8_t> block = update_4k;
+  block.insert(block.end(), method_get.begin(), method_get.end());
+  const auto decoded = lowered.decode(block);
+  BOOST_REQUIRE_EQUAL(decoded.size(), 1);
+  BOOST_CHECK_EQUAL(decoded.front().value_view(), "GET");
+  BOOST_CHECK_EQUAL(lowered.table_size(), 4096);
+
+  // Only at the beginning of a header block
+  rfc7541::decoder in_block;
+  block = method_get;
+  block.insert(block.end(), update_4k.begin(), update_4k.end());
+  BOOST_CHECK_THROW(in_block.decode(block), std::invalid_argument);
+
+  rfc7541::decoder in_continuation;
+  BOOST_CHECK_NO_THROW(in_continuation.decode(method_get, false));
+  BOOST_CHECK_THROW(in_continuation.decode(update_4k), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(Decode_views) {
+  rfc7541::decoder view_decoder;
+  rfc7541::decoder decoder;
+
+  for (const auto &test_request : encoded_with_huffman_data) {
+    const auto encoded_data = std::span<const uint8_t>(test_request.encoded_data).subspan(padding_size);
+
+    rfc7541::header_view views;
+    view_decoder.decode(encoded_data, views);
+    const auto decoded_headers = decoder.decode(encoded_data);
+
+    BOOST_REQUIRE_EQUAL(views.size(), test_request.fields.size());
+    for (std::size_t i = 0; i < views.size(); ++i) {
+      BOOST_CHECK_EQUAL(views[i].name_view(), test_request.fields[i].name_view());
+      BOOST_CHECK_EQUAL(views[i].value_view(), test_request.fields[i].value_view());
+      BOOST_CHECK(rfc7541::header_field(views[i]) == decoded_headers[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Decode_by_fragments) {
+  // Every fragment size splits fields at different positions. The dynamic table must stay in sync
+  for (std::size_t fragment_size = 1; fragment_size < 64; ++fragment_size) {
+    rfc7541::decoder decoder;
+
+    for (const auto &test_request : encoded_with_huffman_data) {
+      auto encoded_data = std::span<const uint8_t>(test_request.encoded_data).subspan(padding_size);
+
+      rfc7541::header decoded_headers;
+      while (!encoded_data.empty()) {
+        auto fragment = encoded_data.first(std::min(fragment_size, encoded_data.size()));
+        encoded_data = encoded_data.subspan(fragment.size());
+
+        auto fields = decoder.decode(fragment, encoded_data.empty());
+        std::move(fields.begin(), fields.end(), std::back_inserter(decoded_headers));
+      }
+
+      BOOST_CHECK(!decoder.has_pending());
+      BOOST_CHECK_EQUAL_COLLECTIONS(decoded_headers.begin(), decoded_headers.end(), test_request.fields.begin(),
+                                    test_request.fields.end());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Decode_incomplete_block) {
+  const auto encoded_data = std::span<const uint8_t>(encoded_with_huffman_data[0].encoded_data).subspan(padding_size);
+  rfc7541::decoder decoder;
+
+  // The block is cut in the middle of the last field
+  auto fields = decoder.decode(encoded_data.first(encoded_data.size() - 3), false);
+  BOOST_CHECK_EQUAL(fields.size(), 3);
+  BOOST_CHECK(decoder.has_pending());
+  BOOST_REQUIRE_THROW(decoder.decode(encoded_data.last(1), true), std::invalid_argument);
+  BOOST_CHECK(!decoder.has_pending());
+}
+
+BOOST_AUTO_TEST_CASE(Decode_split_field_limit) {
+  // A literal without indexing with a new name "x" and a value of 100000 bytes. Only a part of it is sent
+  std::vector<uint8_t> block = {0x00, 0x01, 'x'};
+  auto length = rfc7541::integer::encode(0, 1, 100000);
+  block.insert(block.end(), length.value, length.value + length.length);
+  block.resize(block.size() + 5000, 'a');
+
+  rfc7541::decoder decoder;
+  decoder.set_max_field_size(4096);
+  decoder.decode(std::span<const uint8_t>(block).first(100), false);
+  BOOST_CHECK(decoder.has_pending());
+  BOOST_REQUIRE_THROW(decoder.decode(std::span<const uint8_t>(block).subspan(100), false), std::invalid_argument);
+  BOOST_CHECK(!decoder.has_pending());
+
+  // The same field that fits into the limit is decoded
+  std::vector<uint8_t> small_block = {0x00, 0x01, 'x', 0x0a};
+  small_block.resize(small_block.size() + 10, 'a');
+  decoder.set_max_field_size(small_block.size());
+  decoder.decode(std::span<const uint8_t>(small_block).first(5), false);
+  auto fields = decoder.decode(std::span<const uint8_t>(small_block).subspan(5), true);
+  BOOST_REQUIRE_EQUAL(fields.size(), 1);
+  BOOST_CHECK_EQUAL(fields[0].value_view(), std::string(10, 'a'));
+}
+
+BOOST_AUTO_TEST_CASE(Decode_into_sink) {
+  struct filter_sink : public rfc7541::field_sink {
+    bool accept(std::string_view name) override {
+      ++accept_calls;
+      return name == ":path" || name == "custom-key";
+    }
+    void on_field(const rfc7541::header_field_view &field) override { fields.emplace_back(field); }
+
+    std::size_t accept_calls = 0;
+    rfc7541::header fields;
+  };
+
+  rfc7541::decoder decoder;
+  filter_sink sink;
+  std::size_t total_fields = 0;
+  for (const auto &test_request : encoded_with_huffman_data) {
+    // Skipped fields with incremental indexing must be inserted into the dynamic table anyway.
+    // Otherwise the next requests refer to wrong entries
+    decoder.decode(std::span<const uint8_t>(test_request.encoded_data).subspan(padding_size), sink);
+    total_fields += test_request.fields.size();
+  }
+
+  const rfc7541::header expected = {
+      {":path", "/"}, {":path", "/"}, {":path", "/index.html"}, {"custom-key", "custom-value"}};
+  BOOST_CHECK_EQUAL(sink.accept_calls, total_fields);
+  BOOST_CHECK_EQUAL_COLLECTIONS(sink.fields.begin(), sink.fields.end(), expected.begin(), expected.end());
+
+  // Every field is split between one byte fragments. A field is accepted once when it's complete
+  rfc7541::decoder split_decoder;
+  filter_sink split_sink;
+  const auto &first_request = encoded_with_huffman_data.front();
+  const auto encoded_data = std::span<const uint8_t>(first_request.encoded_data).subspan(padding_size);
+  for (std::size_t i = 0; i < encoded_data.size(); ++i) {
+    split_decoder.decode(encoded_data.subspan(i, 1), split_sink, i + 1 == encoded_data.size());
+  }
+  BOOST_CHECK(!split_decoder.has_pending());
+  BOOST_CHECK_EQUAL(split_sink.accept_calls, first_request.fields.size());
+}
+
+BOOST_AUTO_TEST_CASE(Decode_views_zero_copy) {
+  // C.3.1 without huffman coding
+  const std::vector<uint8_t> request = {0x82, 0x86, 0x84, 0x41, 0x0f, 0x77, 0x77, 0x77, 0x2e, 0x65,
+                                        0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d};
+  rfc7541::decoder decoder;
+  rfc7541::header_view views;
+  decoder.decode(request, views);
+
+  BOOST_REQUIRE_EQUAL(views.size(), 4);
+  BOOST_CHECK_EQUAL(views[3].name_view(), ":authority");
+  BOOST_CHECK_EQUAL(views[3].value_view(), "www.example.com");
+  // A not encoded literal points into the header block
+  BOOST_CHECK(views[3].value().data() == request.data() + 5);
+}
+
+BOOST_AUTO_TEST_CASE(Decode_lazy_huffman) {
+  struct lazy_sink : public rfc7541::field_sink {
+    bool accepts_huffman() const override { return true; }
+    void on_field(const rfc7541::header_field_view &field) override {
+      huffman_flags.push_back(field.is_huffman());
+      fields.emplace_back(field);
+    }
+
+    std::vector<bool> huffman_flags;
+    rfc7541::header fields;
+  };
+
+  // ':authority: www.example.com' without indexing and with incremental indexing. Both huffman encoded
+  const std::vector<uint8_t> request = {0x01, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90,
+                                        0xf4, 0xff, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0,
+                                        0xab, 0x90, 0xf4, 0xff};
+  rfc7541::decoder decoder;
+  lazy_sink sink;
+  decoder.decode(request, sink);
+
+  BOOST_REQUIRE_EQUAL(sink.fields.size(), 2);
+  // An indexed value is decoded since it's inserted into the dynamic table
+  BOOST_CHECK(sink.huffman_flags[0]);
+  BOOST_CHECK(!sink.huffman_flags[1]);
+  BOOST_CHECK(sink.fields[0].is_huffman());
+  BOOST_CHECK_EQUAL(sink.fields[0].value().size(), 15);
+  BOOST_CHECK(!sink.fields[0].is_huffman());
+  BOOST_CHECK_EQUAL(sink.fields[0].value_view(), "www.example.com");
+  BOOST_CHECK_EQUAL(sink.fields[1].value_view(), "www.example.com");
+
+  // The default sink gets decoded values
+  rfc7541::decoder eager_decoder;
+  rfc7541::header_view views;
+  eager_decoder.decode(request, views);
+  BOOST_REQUIRE_EQUAL(views.size(), 2);
+  BOOST_CHECK(!views[0].is_huffman());
+  BOOST_CHECK_EQUAL(views[0].value_view(), "www.example.com");
+
+  // An invalid padding is detected while decoding even if a value stays encoded
+  const std::vector<uint8_t> invalid_padding = {0x01, 0x81, 0x00};
+  rfc7541::decoder invalid_decoder;
+  BOOST_REQUIRE_THROW(invalid_decoder.decode(invalid_padding, sink), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(Decode_atoms) {
+  // ':status: 200' indexed, 'content-length: 1' with a static name, 'x-id: 1' and 'x-other: 1' with literal names,
+  // 'content-type: 1' with a literal name
+  const std::vector<uint8_t> response = {0x88, 0x0f, 0x0d, 0x01, 0x31, 0x00, 0x04, 0x78, 0x2d, 0x69, 0x64,
+                                         0x01, 0x31, 0x00, 0x07, 0x78, 0x2d, 0x6f, 0x74, 0x68, 0x65, 0x72,
+                                         0x01, 0x31, 0x00, 0x0c, 0x63, 0x6f, 0x6e, 0x74, 0x65, 0x6e, 0x74,
+                                         0x2d, 0x74, 0x79, 0x70, 0x65, 0x01, 0x31};
+  rfc7541::decoder decoder;
+  auto x_id = decoder.add_atom("x-id");
+  rfc7541::header_view views;
+  decoder.decode(response, views);
+
+  BOOST_REQUIRE_EQUAL(views.size(), 5);
+  BOOST_CHECK_EQUAL(views[0].name_atom(), rfc7541::atoms::status);
+  BOOST_CHECK_EQUAL(views[1].name_atom(), rfc7541::atoms::content_length);
+  BOOST_CHECK_EQUAL(views[2].name_atom(), x_id);
+  BOOST_CHECK_EQUAL(views[3].name_atom(), rfc7541::atoms::none);
+  BOOST_CHECK_EQUAL(views[4].name_atom(), rfc7541::atoms::content_type);
+  BOOST_CHECK_EQUAL(rfc7541::header_field(views[2]).name_atom(), x_id);
+
+  // Names from the dynamic table
+  const std::vector<uint8_t> indexed = {0x40, 0x04, 0x78, 0x2d, 0x69, 0x64, 0x01, 0x32, 0xbe};
+  views.clear();
+  decoder.decode(indexed, views);
+  BOOST_REQUIRE_EQUAL(views.size(), 2);
+  BOOST_CHECK_EQUAL(views[0].name_atom(), x_id);
+  BOOST_CHECK_EQUAL(views[1].name_atom(), x_id);
+}
+
 // BOOST_AUTO_TEST_CASE(TestDecoder) {
 //   std::vector<uint8_t> encoded_data = {
 //       0x82, 0x87, 0x84, 0x41, 0x8b, 0xf1, 0xe3, 0xc2, 0xf3, 0x19, 0x33, 0xdb, 0x1a, 0xe4, 0x3d, 0x3f,
@@ -1,11 +1,47 @@
+#include <algorithm>
+#include <random>
+#include <string_view>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
 
 #include <hpack/huffman.h>
+#include <hpack/huffman_cache.h>
 
 BOOST_AUTO_TEST_SUITE(HPack_Huffman)
 
+namespace {
+// Packs huffman codes of given symbols and pads the last byte by 'padding' bits
+std::vector<uint8_t> pack(const std::vector<uint16_t> &symbols, bool padding = true) {
+  std::vector<uint8_t> result;
+  uint64_t bits = 0;
+  unsigned len = 0;
+  for (auto s : symbols) {
+    const auto code = rfc7541::huffman::encode(s);
+    bits = (bits << code.bitLength) | (code.huffmanCode >> (32 - code.bitLength));
+    len += code.bitLength;
+    while (len >= 8) {
+      len -= 8;
+      result.push_back(uint8_t(bits >> len));
+    }
+  }
+  if (len > 0) {
+    auto tail = uint8_t(bits << (8 - len));
+    result.push_back(padding ? tail | uint8_t(0xff >> len) : tail);
+  }
+  return result;
+}
+
+std::vector<uint8_t> decode_string(std::span<const uint8_t> src, bool &accepted) {
+  std::vector<uint8_t> result(rfc7541::huffman::max_decoded_size(src.size()));
+  rfc7541::huffman::decode_state state;
+  auto *last = rfc7541::huffman::decode(src, result.data(), state);
+  accepted = state.accepted;
+  result.resize(last - result.data());
+  return result;
+}
+} // namespace
+
 BOOST_AUTO_TEST_CASE(Encode_Decode_All_Symbols) {
   const auto allowed_length = rfc7541::huffman::allowed_code_lengths();
 
@@ -35,4 +71,157 @@ BOOST_AUTO_TEST_CASE(Decode_Wrong_Codes) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(Decode_String_All_Symbols) {
+  std::vector<uint16_t> symbols;
+  for (uint16_t value = 0; value < 256; ++value) {
+    symbols.push_back(value);
+    symbols.push_back(255 - value);
+  }
+  const auto encoded = pack(symbols);
+
+  bool accepted = false;
+  const auto decoded = decode_string(encoded, accepted);
+  BOOST_CHECK(accepted);
+  BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), symbols.begin(), symbols.end());
+}
+
+BOOST_AUTO_TEST_CASE(Decode_String_By_Pieces) {
+  std::vector<uint16_t> symbols;
+  const std::string_view text = "set-cookie: id=a3fWa; Expires=Thu, 21 Oct 2021 07:28:00 GMT; Secure; HttpOnly";
+  std::copy(text.begin(), text.end(), std::back_inserter(symbols));
+  const auto encoded = pack(symbols);
+
+  for (std::size_t split = 0; split <= encoded.size(); ++split) {
+    std::vector<uint8_t> decoded(rfc7541::huffman::max_decoded_size(encoded.size()));
+    rfc7541::huffman::decode_state state;
+    auto *last = rfc7541::huffman::decode(std::span(encoded).first(split), decoded.data(), state);
+    last = rfc7541::huffman::decode(std::span(encoded).subspan(split), last, state);
+    decoded.resize(last - decoded.data());
+
+    BOOST_CHECK(state.accepted);
+    BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), text.begin(), text.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Decode_String_Invalid_Padding) {
+  bool accepted = true;
+
+  // 'a' is 00011. Padded by zeros instead of ones
+  const std::vector<uint8_t> zero_padding = pack({'a'}, false);
+  decode_string(zero_padding, accepted);
+  BOOST_CHECK(!accepted);
+
+  // 'a' + a full byte of ones. Padding is longer than 7 bits
+  const std::vector<uint8_t> long_padding = {0x1f, 0xff};
+  decode_string(long_padding, accepted);
+  BOOST_CHECK(!accepted);
+
+  // Valid padding
+  const std::vector<uint8_t> valid_padding = {0x1f};
+  const auto decoded = decode_string(valid_padding, accepted);
+  BOOST_CHECK(accepted);
+  BOOST_CHECK_EQUAL(decoded.size(), 1);
+  BOOST_CHECK_EQUAL(decoded.front(), 'a');
+}
+
+BOOST_AUTO_TEST_CASE(Decode_String_EOS) {
+  const auto encoded = pack({'a', rfc7541::huffman::EOS, 'b'});
+  bool accepted = false;
+  BOOST_REQUIRE_THROW(decode_string(encoded, accepted), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(Estimate_Len) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> printable(0x20, 0x7e);
+  std::uniform_int_distribution<int> any(0, 255);
+
+  // Vectorized blocks, scalar blocks with non-printable bytes and tails
+  for (std::size_t size = 0; size < 200; ++size) {
+    for (bool ascii : {true, false}) {
+      std::vector<uint8_t> data(size);
+      for (auto &byte : data) {
+        byte = static_cast<uint8_t>(ascii || size % 3 != 0 ? printable(gen) : any(gen));
+      }
+      if (!ascii && size != 0) {
+        data[size / 2] = '\n';
+      }
+      std::size_t expected = 0;
+      for (auto byte : data) {
+        expected += rfc7541::huffman::encode(byte).bitLength;
+      }
+      BOOST_CHECK_EQUAL(rfc7541::huffman::estimate_len(data), expected);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Encode_String) {
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> any(0, 255);
+
+  for (std::size_t size = 0; size < 300; ++size) {
+    std::vector<uint8_t> data(size);
+    std::vector<uint16_t> symbols;
+    for (auto &byte : data) {
+      byte = static_cast<uint8_t>(size % 2 == 0 ? any(gen) : 'a' + any(gen) % 26);
+      symbols.push_back(byte);
+    }
+
+    // The output has no spare room
+    std::vector<uint8_t> encoded(rfc7541::huffman::encoded_size(data));
+    auto *last = rfc7541::huffman::encode(data, encoded);
+    BOOST_CHECK_EQUAL(last - encoded.data(), encoded.size());
+    const auto expected = pack(symbols);
+    BOOST_CHECK_EQUAL_COLLECTIONS(encoded.begin(), encoded.end(), expected.begin(), expected.end());
+
+    bool accepted = false;
+    const auto decoded = decode_string(encoded, accepted);
+    BOOST_CHECK(accepted);
+    BOOST_CHECK_EQUAL_COLLECTIONS(decoded.begin(), decoded.end(), data.begin(), data.end());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Cache_Eviction) {
+  auto make_value = [](char c) { return std::vector<uint8_t>(100, uint8_t(c)); };
+  // One shard keeps at least 2 entries of 100 byte values. Sizes differ by symbol code lengths
+  const auto entry_cost = rfc7541::huffman_cache::entry(make_value('a'), false).cost();
+  std::size_t max_cost = 0;
+  for (char c = '0'; c <= 'z'; ++c) {
+    max_cost = std::max(max_cost, rfc7541::huffman_cache::entry(make_value(c), false).cost());
+  }
+  rfc7541::huffman_cache cache(8 * (max_cost * 2), 64);
+
+  BOOST_CHECK(!cache.get(std::vector<uint8_t>(63, 'a')));
+
+  const auto a = make_value('a');
+  auto first = cache.get(a);
+  BOOST_REQUIRE(first);
+  std::vector<uint8_t> expected(rfc7541::huffman::encoded_size(a));
+  rfc7541::huffman::encode(a, expected);
+  BOOST_CHECK_EQUAL_COLLECTIONS(first->encoded().begin(), first->encoded().end(), expected.begin(), expected.end());
+  BOOST_CHECK(cache.get(a) == first);
+  BOOST_CHECK_EQUAL(cache.count(), 1);
+  BOOST_CHECK_EQUAL(cache.size(), entry_cost);
+
+  // Values of one shard evict entries that aren't used since the last check. An evicted entry is alive while it's
+  // referenced
+  std::size_t inserted = 1;
+  for (char c = 'b'; c <= 'z'; ++c) {
+    cache.get(make_value(c));
+    cache.get(a);
+    ++inserted;
+  }
+  BOOST_CHECK(cache.get(a) == first);
+  BOOST_CHECK_LT(cache.count(), inserted);
+  BOOST_CHECK_LE(cache.size(), 8 * (max_cost * 2));
+
+  auto sensitive = cache.get(make_value('0'), true);
+  BOOST_CHECK(sensitive->is_sensitive());
+  BOOST_CHECK(cache.get(a, true)->is_sensitive());
+
+  cache.clear();
+  BOOST_CHECK_EQUAL(cache.count(), 0);
+  BOOST_CHECK_EQUAL(cache.size(), 0);
+  BOOST_CHECK_EQUAL(first->value().size(), 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
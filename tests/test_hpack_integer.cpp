@@ -104,4 +104,31 @@ BOOST_AUTO_TEST_CASE(Encode_max) {
   BOOST_CHECK_EQUAL(result.length, 5);
 }
 
+BOOST_AUTO_TEST_CASE(Encode_decode_all_lengths) {
+  // Every prefix size, every encoded length and every source size around the 8 byte fast path
+  for (unsigned bits = 1; bits <= 4; ++bits) {
+    uint32_t mask = (1u << (8 - bits)) - 1;
+    const uint32_t max = rfc7541::integer::MAX_HPACK_INT;
+    for (uint32_t v : {0u, 1u, mask - 1, mask, mask + 1, mask + 127, mask + 128, mask + 1337, mask + (1u << 14) - 1,
+                       mask + (1u << 14), mask + (1u << 21) - 1, mask + (1u << 21), max}) {
+      const auto encoded = rfc7541::integer::encode(uint8_t(0x80 >> (bits - 1)), bits, v);
+      BOOST_CHECK_EQUAL(encoded.value[0] & ~mask, 0x80 >> (bits - 1));
+
+      for (std::size_t extra = 0; extra < 10; ++extra) {
+        std::vector<uint8_t> raw(encoded.value, encoded.value + encoded.length);
+        raw.insert(raw.end(), extra, 0xff);
+        const auto decoded = rfc7541::integer::decode(bits, raw);
+        BOOST_CHECK_EQUAL(decoded.value, v);
+        BOOST_CHECK_EQUAL(decoded.used_bytes, encoded.length);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Decode_overflow_fast_path) {
+  // 4 continuation bytes with 28 bits are decoded by the fast path. A value is greater than MAX_HPACK_INT
+  const std::vector<uint8_t> raw = {0x0f, 0xff, 0xff, 0xff, 0x7f, 0x00, 0x00, 0x00};
+  BOOST_REQUIRE_THROW(rfc7541::integer::decode(4, raw), std::overflow_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,132 @@
+#include <boost/test/unit_test.hpp>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <hpack/decoder.h>
+#include <hpack/encoder.h>
+
+namespace {
+// Encodes and decodes a request checking that the encoder and decoder tables are in sync
+void round_trip(rfc7541::encoder &encoder, rfc7541::decoder &decoder,
+                const std::deque<rfc7541::header_field> &fields) {
+  auto [buffers, count] = encoder.encode(fields, 1 << 16);
+  BOOST_REQUIRE_EQUAL(count, fields.size());
+
+  std::vector<uint8_t> block;
+  for (const auto &b : buffers) {
+    block.insert(block.end(), b.data_view().begin(), b.data_view().end());
+  }
+
+  auto decoded = decoder.decode(block);
+  BOOST_REQUIRE_EQUAL(decoded.size(), fields.size());
+  for (std::size_t i = 0; i < fields.size(); ++i) {
+    BOOST_REQUIRE_EQUAL(decoded[i].name_view(), fields[i].name_view());
+    BOOST_REQUIRE_EQUAL(decoded[i].value_view(), fields[i].value_view());
+  }
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(HPack_Indexing_Policy)
+
+BOOST_AUTO_TEST_CASE(Name_rules) {
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+
+  for (int i = 0; i < 100; ++i) {
+    round_trip(encoder, decoder, {{"x-request-id", "id-" + std::to_string(i)}, {"x-tenant", "tenant-a"}});
+  }
+
+  const auto &counters = encoder.get_indexing_policy().counters();
+  BOOST_CHECK_EQUAL(counters.by_name_rule, 100);
+  // 'x-tenant' is inserted once and then it is found in the table
+  BOOST_CHECK_EQUAL(counters.indexed, 1);
+  BOOST_CHECK_EQUAL(counters.hits, 99);
+}
+
+BOOST_AUTO_TEST_CASE(Low_reuse) {
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+
+  for (int i = 0; i < 1000; ++i) {
+    round_trip(encoder, decoder, {{"x-unique", std::to_string(i)}, {"x-shared", std::to_string(i % 4)}});
+  }
+
+  const auto &counters = encoder.get_indexing_policy().counters();
+  // 'x-unique' is indexed while warming up and in rare probes only
+  BOOST_CHECK_GT(counters.low_reuse, 900);
+  BOOST_CHECK_LT(counters.indexed, 50);
+  BOOST_CHECK_GT(counters.hits, 990);
+}
+
+BOOST_AUTO_TEST_CASE(Low_reuse_without_probes) {
+  rfc7541::adaptive_indexing_policy::config conf;
+  conf.probe_interval = 0;
+  const auto warmup = conf.warmup;
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+  encoder.set_indexing_policy(std::make_unique<rfc7541::adaptive_indexing_policy>(std::move(conf)));
+
+  for (int i = 0; i < 1000; ++i) {
+    round_trip(encoder, decoder, {{"x-unique", std::to_string(i)}});
+  }
+
+  // 'x-unique' is indexed while warming up only
+  const auto &counters = encoder.get_indexing_policy().counters();
+  BOOST_CHECK_EQUAL(counters.indexed, warmup);
+  BOOST_CHECK_EQUAL(counters.low_reuse, 1000 - warmup);
+}
+
+BOOST_AUTO_TEST_CASE(Too_large) {
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+
+  round_trip(encoder, decoder, {{"x-large", std::string(2000, 'a')}, {"x-small", "a"}});
+  const auto &counters = encoder.get_indexing_policy().counters();
+  BOOST_CHECK_EQUAL(counters.too_large, 1);
+  BOOST_CHECK_EQUAL(counters.indexed, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Custom_policy) {
+  struct no_index_policy : public rfc7541::indexing_policy {
+    rfc7541::literal_decision decide(const rfc7541::header_field &, std::size_t) const override { return {}; }
+    bool huffman(std::size_t, std::size_t) const override { return false; }
+    void on_encoded(const rfc7541::header_field &, const rfc7541::literal_decision &) override {}
+    void on_hit(const rfc7541::header_field &) override { ++counters_value.hits; }
+    void on_string(bool) override { ++counters_value.raw; }
+    const rfc7541::indexing_counters &counters() const noexcept override { return counters_value; }
+
+    rfc7541::indexing_counters counters_value;
+  };
+
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+  encoder.set_indexing_policy(std::make_unique<no_index_policy>());
+
+  round_trip(encoder, decoder, {{"x-name", "value"}});
+  round_trip(encoder, decoder, {{"x-name", "value"}});
+  BOOST_CHECK_EQUAL(encoder.get_indexing_policy().counters().hits, 0);
+  BOOST_CHECK_EQUAL(encoder.get_indexing_policy().counters().raw, 4);
+}
+
+BOOST_AUTO_TEST_CASE(Fields_left_for_next_fragment) {
+  rfc7541::encoder encoder;
+  std::deque<rfc7541::header_field> fields = {{"x-first", "value-1"}, {"x-second", "value-2"}};
+
+  // Only the first field fits. The second one is counted when it is written
+  auto [first_block, first_count] = encoder.encode(fields, 20);
+  BOOST_REQUIRE_EQUAL(first_count, 1);
+  const auto &counters = encoder.get_indexing_policy().counters();
+  BOOST_CHECK_EQUAL(counters.indexed, 1);
+  BOOST_CHECK_EQUAL(counters.huffman + counters.raw, 2);
+
+  fields.pop_front();
+  auto [second_block, second_count] = encoder.encode(fields, 20);
+  BOOST_REQUIRE_EQUAL(second_count, 1);
+  BOOST_CHECK_EQUAL(counters.indexed, 2);
+  BOOST_CHECK_EQUAL(counters.huffman + counters.raw, 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
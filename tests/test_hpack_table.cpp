@@ -0,0 +1,204 @@
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <hpack/atom.h>
+#include <hpack/dynamic_table.h>
+#include <hpack/indexed_dynamic_table.h>
+#include <hpack/static_table.h>
+
+namespace {
+std::span<const uint8_t> as_span(std::string_view str) {
+  return {reinterpret_cast<const uint8_t *>(str.data()), str.size()};
+}
+
+std::string_view as_view(std::span<const uint8_t> data) {
+  return {reinterpret_cast<const char *>(data.data()), data.size()};
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(HPack_Table)
+
+BOOST_AUTO_TEST_CASE(Insert_and_evict) {
+  // 3 entries of 42 bytes each fit
+  rfc7541::dynamic_table table(128);
+  table.insert(as_span("name1"), as_span("value"));
+  table.insert(as_span("name2"), as_span("value"));
+  table.insert(as_span("name3"), as_span("value"));
+  BOOST_REQUIRE_EQUAL(table.size(), 3);
+  BOOST_CHECK_EQUAL(as_view(table.at(1).first), "name3");
+  BOOST_CHECK_EQUAL(as_view(table.at(3).first), "name1");
+
+  table.insert(as_span("name4"), as_span("value"));
+  BOOST_REQUIRE_EQUAL(table.size(), 3);
+  BOOST_CHECK_EQUAL(as_view(table.at(1).first), "name4");
+  BOOST_CHECK_EQUAL(as_view(table.at(3).first), "name2");
+  BOOST_CHECK_EQUAL(as_view(table.at(3).second), "value");
+  BOOST_REQUIRE_THROW(table.at(4), std::runtime_error);
+  BOOST_REQUIRE_THROW(table.at(0), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(Insert_too_large) {
+  rfc7541::dynamic_table table(64);
+  table.insert(as_span("name"), as_span("value"));
+  BOOST_REQUIRE_EQUAL(table.size(), 1);
+
+  // RFC 7541 4.4. The table is emptied and the entry isn't inserted
+  table.insert(as_span("name"), as_span(std::string(64, 'x')));
+  BOOST_CHECK_EQUAL(table.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(Insert_wrap_around) {
+  // Entries of various sizes make the live region to be moved many times
+  rfc7541::dynamic_table table(256);
+  for (std::size_t i = 0; i < 1000; ++i) {
+    auto name = std::to_string(i);
+    auto value = std::string(i % 97, char('a' + i % 26));
+    table.insert(as_span(name), as_span(value));
+
+    BOOST_REQUIRE_EQUAL(as_view(table.at(1).first), name);
+    BOOST_REQUIRE_EQUAL(as_view(table.at(1).second), value);
+    if (table.size() > 1) {
+      auto prev = i - 1;
+      BOOST_REQUIRE_EQUAL(as_view(table.at(2).first), std::to_string(prev));
+      BOOST_REQUIRE_EQUAL(as_view(table.at(2).second), std::string(prev % 97, char('a' + prev % 26)));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Update_size) {
+  rfc7541::dynamic_table table(128);
+  table.insert(as_span("name1"), as_span("value"));
+  table.insert(as_span("name2"), as_span("value"));
+
+  table.update_size(50);
+  BOOST_REQUIRE_EQUAL(table.size(), 1);
+  BOOST_CHECK_EQUAL(as_view(table.at(1).first), "name2");
+
+  // The storage grows and keeps entries
+  table.update_size(1024);
+  for (int i = 0; i < 20; ++i) {
+    table.insert(as_span("name" + std::to_string(i)), as_span("value"));
+  }
+  BOOST_REQUIRE_EQUAL(table.size(), 21);
+  BOOST_CHECK_EQUAL(as_view(table.at(21).first), "name2");
+  BOOST_CHECK_EQUAL(as_view(table.at(1).first), "name19");
+}
+
+BOOST_AUTO_TEST_CASE(Indexed_field_index) {
+  rfc7541::indexed_dynamic_table table(128);
+  table.insert(as_span("name1"), as_span("value1"));
+  table.insert(as_span("name2"), as_span("value2"));
+  table.insert(as_span("name1"), as_span("value1"));
+
+  BOOST_CHECK(table.field_index(as_span("name1"), as_span("value1")) == std::make_pair(1, true));
+  BOOST_CHECK(table.field_index(as_span("name2"), as_span("value2")) == std::make_pair(2, true));
+  BOOST_CHECK(table.field_index(as_span("name2"), as_span("other")).first == 2);
+  BOOST_CHECK(!table.field_index(as_span("name2"), as_span("other")).second);
+  BOOST_CHECK_EQUAL(table.field_index(as_span("name3"), as_span("value")).first, -1);
+
+  // The first name1 was evicted by the third insertion, now name2 is evicted
+  table.insert(as_span("name3"), as_span(std::string(40, 'x')));
+  BOOST_REQUIRE_EQUAL(table.size(), 2);
+  BOOST_CHECK_EQUAL(table.field_index(as_span("name2"), as_span("value2")).first, -1);
+  BOOST_CHECK(table.field_index(as_span("name1"), as_span("value1")) == std::make_pair(2, true));
+  BOOST_CHECK(table.field_index(as_span("name3"), as_span(std::string(40, 'x'))) == std::make_pair(1, true));
+
+  table.update_size(0);
+  BOOST_CHECK_EQUAL(table.size(), 0);
+  BOOST_CHECK_EQUAL(table.field_index(as_span("name1"), as_span("value1")).first, -1);
+}
+
+BOOST_AUTO_TEST_CASE(Indexed_matches_linear_search) {
+  // Few names and values make a lot of duplicates
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, 15);
+  rfc7541::indexed_dynamic_table table(512);
+
+  for (int i = 0; i < 5000; ++i) {
+    auto name = "name" + std::to_string(dist(gen));
+    auto value = std::string(dist(gen) * 4, 'v');
+    if (i % 1000 == 999) {
+      table.update_size(i % 2000 == 999 ? 128 : 1024);
+    }
+
+    // The newest entry has the lowest index
+    std::pair<int, bool> expected{-1, false};
+    for (std::size_t j = table.size(); j != 0; --j) {
+      auto [entry_name, entry_value] = table.at(j);
+      if (as_view(entry_name) == name) {
+        expected = {int(j), as_view(entry_value) == value};
+      }
+    }
+    for (std::size_t j = table.size(); j != 0; --j) {
+      auto [entry_name, entry_value] = table.at(j);
+      if (as_view(entry_name) == name && as_view(entry_value) == value) {
+        expected = {int(j), true};
+      }
+    }
+    BOOST_REQUIRE(table.field_index(as_span(name), as_span(value)) == expected);
+
+    table.insert(as_span(name), as_span(value));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Static_field_index) {
+  namespace st = rfc7541::static_table;
+  BOOST_REQUIRE_EQUAL(st::size(), 61);
+
+  for (std::size_t i = 1; i <= st::size(); ++i) {
+    auto [name, value] = st::at(i);
+    auto first = i;
+    while (first > 1 && as_view(st::at(first - 1).first) == as_view(name)) {
+      --first;
+    }
+    BOOST_CHECK_EQUAL(st::name_index(name), first);
+    auto [index, has_value] = st::field_index(name, value);
+    BOOST_CHECK_EQUAL(index, i);
+    BOOST_CHECK(has_value);
+  }
+
+  BOOST_CHECK(st::field_index(as_span(":method"), as_span("GET")) == std::make_pair(2, true));
+  BOOST_CHECK(st::field_index(as_span("accept-encoding"), as_span("gzip, deflate")) == std::make_pair(16, true));
+  BOOST_CHECK(st::field_index(as_span(":status"), as_span("201")) == std::make_pair(8, false));
+  BOOST_CHECK(st::field_index(as_span("user-agent"), as_span("h2pp")) == std::make_pair(58, false));
+  BOOST_CHECK(st::field_index(as_span("x-custom"), as_span("")) == std::make_pair(-1, false));
+  BOOST_CHECK(st::field_index(as_span(""), as_span("")) == std::make_pair(-1, false));
+  BOOST_CHECK_EQUAL(st::name_index(as_span(":statu")), -1);
+  BOOST_CHECK_EQUAL(st::name_index(as_span("Accept")), -1);
+}
+
+BOOST_AUTO_TEST_CASE(Header_atoms) {
+  namespace st = rfc7541::static_table;
+  // Atom constants are the first static table indexes of names
+  for (auto [name, a] : {std::pair<std::string_view, rfc7541::atom>{":authority", rfc7541::atoms::authority},
+                         {":method", rfc7541::atoms::method},
+                         {":path", rfc7541::atoms::path},
+                         {":status", rfc7541::atoms::status},
+                         {"content-length", rfc7541::atoms::content_length},
+                         {"content-type", rfc7541::atoms::content_type},
+                         {"set-cookie", rfc7541::atoms::set_cookie},
+                         {"vary", rfc7541::atoms::vary}}) {
+    BOOST_CHECK_EQUAL(st::name_index(as_span(name)), a);
+  }
+  BOOST_CHECK_EQUAL(rfc7541::atoms::first_extra, st::size() + 1);
+  for (std::size_t i = 1; i <= st::size(); ++i) {
+    BOOST_CHECK_EQUAL(rfc7541::atom_table::find_static(i), st::name_index(st::at(i).first));
+  }
+
+  rfc7541::atom_table atoms;
+  BOOST_CHECK_EQUAL(atoms.find(as_span("x-request-id")), rfc7541::atoms::none);
+  auto request_id = atoms.add("x-request-id");
+  BOOST_CHECK_EQUAL(request_id, rfc7541::atoms::first_extra);
+  BOOST_CHECK_EQUAL(atoms.add("x-trace"), rfc7541::atoms::first_extra + 1);
+  BOOST_CHECK_EQUAL(atoms.add("x-request-id"), request_id);
+  BOOST_CHECK_EQUAL(atoms.add(":status"), rfc7541::atoms::status);
+  BOOST_CHECK_EQUAL(atoms.find(as_span("x-request-id")), request_id);
+  BOOST_CHECK_EQUAL(atoms.find(as_span("x-request")), rfc7541::atoms::none);
+  BOOST_CHECK_EQUAL(atoms.size(), rfc7541::atoms::first_extra + 2);
+  BOOST_CHECK_THROW(atoms.add(""), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+
+#include <deque>
+#include <vector>
+
+#include <hpack/decoder.h>
+#include <hpack/encoder.h>
+#include <hpack/header_template.h>
+
+BOOST_AUTO_TEST_SUITE(HPack_Template)
+
+BOOST_AUTO_TEST_CASE(Static_encodings) {
+  const rfc7541::header_template tmpl = {
+      {"user-agent", "h2pp"},
+      {":scheme", "https"},
+      {"accept-encoding", "gzip, deflate"},
+      {":authority", "api.example.com"},
+      {"authorization", "Bearer token", rfc7541::index_type::NEVER_INDEX},
+  };
+
+  // Pseudo-headers are the first
+  BOOST_REQUIRE_EQUAL(tmpl.pseudo_headers().size(), 2);
+  BOOST_CHECK_EQUAL(tmpl.pseudo_headers()[0].field.name_view(), ":scheme");
+  BOOST_CHECK_EQUAL(tmpl.pseudo_headers()[1].field.name_view(), ":authority");
+  BOOST_REQUIRE_EQUAL(tmpl.regular_headers().size(), 3);
+
+  // Static table indexes
+  BOOST_CHECK(tmpl.find(":scheme")->encoded == std::vector<uint8_t>{0x87});
+  BOOST_CHECK(tmpl.find("accept-encoding")->encoded == std::vector<uint8_t>{0x90});
+  // Never indexed literal with a static name index 23
+  const auto &authorization = tmpl.find("authorization")->encoded;
+  BOOST_REQUIRE(!authorization.empty());
+  BOOST_CHECK_EQUAL(authorization[0], 0x1f);
+  BOOST_CHECK_EQUAL(authorization[1], 23 - 15);
+  // Worth to be in the dynamic table
+  BOOST_CHECK(tmpl.find(":authority")->encoded.empty());
+  BOOST_CHECK(tmpl.find("user-agent")->encoded.empty());
+  BOOST_CHECK(tmpl.find("accept") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(Encode_with_template) {
+  const rfc7541::header_template tmpl = {
+      {":scheme", "https"},
+      {":authority", "api.example.com"},
+      {"accept-encoding", "gzip, deflate"},
+      {"authorization", "Bearer token", rfc7541::index_type::NEVER_INDEX},
+  };
+  const std::deque<rfc7541::header_field> own = {{":method", "GET"}, {":path", "/items"}, {"x-custom", "1"}};
+
+  std::vector<rfc7541::encoder::field_ref> refs;
+  std::deque<rfc7541::header_field> expected;
+  for (const auto &e : tmpl.pseudo_headers()) {
+    refs.push_back({&e.field, e.encoded});
+    expected.push_back(e.field);
+  }
+  for (const auto &f : own) {
+    refs.push_back({&f, {}});
+    expected.push_back(f);
+  }
+  for (const auto &e : tmpl.regular_headers()) {
+    refs.push_back({&e.field, e.encoded});
+    expected.push_back(e.field);
+  }
+
+  rfc7541::encoder encoder;
+  rfc7541::decoder decoder;
+  for (int i = 0; i < 3; ++i) {
+    auto [buffers, count] = encoder.encode(refs, 4096);
+    BOOST_REQUIRE_EQUAL(count, refs.size());
+
+    auto decoded = decoder.decode(buffers.front().data_view());
+    BOOST_REQUIRE_EQUAL(decoded.size(), expected.size());
+    for (std::size_t j = 0; j < decoded.size(); ++j) {
+      BOOST_CHECK_EQUAL(decoded[j].name_view(), expected[j].name_view());
+      BOOST_CHECK_EQUAL(decoded[j].value_view(), expected[j].value_view());
+      BOOST_CHECK(decoded[j].type() == expected[j].type());
+    }
+  }
+
+  // A size limit stops on a ready representation too
+  auto [buffers, count] = encoder.encode(refs, 1);
+  BOOST_CHECK_EQUAL(count, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
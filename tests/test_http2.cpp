@@ -1,7 +1,321 @@
 #define BOOST_TEST_MODULE HTTP2
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include <base_client.h>
 #include <frame.h>
+#include <hpack/encoder.h>
+#include <hpack/header_template.h>
+#include <read_buffer_pool.h>
+#include <stream.h>
+#include <utils/buffer_slice.h>
+
+namespace {
+std::vector<uint8_t> make_frame(http2::frame_type type, uint8_t flags, uint32_t stream_id,
+                                std::vector<uint8_t> payload = {}) {
+  auto size = payload.size();
+  std::vector<uint8_t> raw = {uint8_t(size >> 16), uint8_t(size >> 8), uint8_t(size), uint8_t(type), flags,
+                              uint8_t(stream_id >> 24), uint8_t(stream_id >> 16), uint8_t(stream_id >> 8),
+                              uint8_t(stream_id)};
+  raw.insert(raw.end(), payload.begin(), payload.end());
+  return raw;
+}
+
+// Exposes the transport independent receive path
+class test_client : public http2::base_client {
+public:
+  using http2::base_client::base_client;
+  using http2::base_client::acquire_read_buffer;
+  using http2::base_client::on_read;
+
+protected:
+  void init_write() override {}
+};
+
+struct type_name {
+  std::string operator()(const http2::ping_frame &) const { return "ping"; }
+  std::string operator()(const http2::header_frame &) const { return "headers"; }
+  std::string operator()(const http2::window_update_frame &) const { return "window_update"; }
+  template <typename Frame> std::string operator()(const Frame &) const { return "other"; }
+};
+} // namespace
 
 BOOST_AUTO_TEST_SUITE(Frame_analysis)
+
+BOOST_AUTO_TEST_CASE(Parse_valid_frames) {
+  const auto ping = make_frame(http2::frame_type::PING, http2::flags::ACK, 0, std::vector<uint8_t>(8, 1));
+  auto parsed = http2::frame_analyzer::parse(ping, 16384);
+  BOOST_REQUIRE(parsed.has_value());
+  BOOST_CHECK(parsed->is_complete());
+  BOOST_CHECK_EQUAL(parsed->visit(type_name{}), "ping");
+  BOOST_CHECK_EQUAL(parsed->frame_header().raw_bytes().size(), ping.size());
+
+  // A header is validated before a frame is complete
+  auto headers = make_frame(http2::frame_type::HEADERS, http2::flags::END_HEADERS, 1, {0x82, 0x86});
+  headers.pop_back();
+  auto incomplete = http2::frame_analyzer::parse(headers, 16384);
+  BOOST_REQUIRE(incomplete.has_value());
+  BOOST_CHECK(!incomplete->is_complete());
+  BOOST_CHECK_EQUAL(incomplete->visit(type_name{}), "headers");
+
+  const auto update = make_frame(http2::frame_type::WINDOW_UPDATE, 0, 0, {0, 0, 1, 0});
+  auto window_update = http2::frame_analyzer::parse(update, 16384);
+  BOOST_REQUIRE(window_update.has_value());
+  BOOST_CHECK_EQUAL(window_update->visit(type_name{}), "window_update");
+}
+
+BOOST_AUTO_TEST_CASE(Parse_invalid_frames) {
+  auto error = [](const std::vector<uint8_t> &raw, std::size_t max_frame_size = 16384) {
+    auto parsed = http2::frame_analyzer::parse(raw, max_frame_size);
+    BOOST_REQUIRE(parsed.has_error());
+    return parsed.error();
+  };
+  using http2::error_code;
+
+  BOOST_CHECK(error({0, 0, 0}) == make_error_code(error_code::FRAME_SIZE_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type(0x0a), 0, 0)) == make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::DATA, 0, 1, std::vector<uint8_t>(100)), 99) ==
+              make_error_code(error_code::FRAME_SIZE_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::DATA, 0, 0)) == make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::HEADERS, http2::flags::ACK | 0x2, 1, {0x82})) ==
+              make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::HEADERS, http2::flags::END_HEADERS, 1)) ==
+              make_error_code(error_code::FRAME_SIZE_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::SETTINGS, 0, 1)) == make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::SETTINGS, 0, 0, {0, 1, 0})) ==
+              make_error_code(error_code::FRAME_SIZE_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::PING, 0, 3, std::vector<uint8_t>(8))) ==
+              make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::WINDOW_UPDATE, 1, 0, {0, 0, 0, 1})) ==
+              make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::CONTINUATION, 0, 0, {0x82})) ==
+              make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK(error(make_frame(http2::frame_type::PUSH_PROMISE, 0, 1, {0, 0, 0, 2})) ==
+              make_error_code(error_code::INTERNAL_ERROR));
+}
+
+BOOST_AUTO_TEST_CASE(Split_frame_batch) {
+  using http2::error_code;
+
+  std::vector<uint8_t> raw;
+  for (const auto &frame : {make_frame(http2::frame_type::PING, 0, 0, std::vector<uint8_t>(8)),
+                            make_frame(http2::frame_type::HEADERS, http2::flags::END_HEADERS, 1, {0x82}),
+                            make_frame(http2::frame_type::WINDOW_UPDATE, 0, 1, {0, 0, 1, 0})}) {
+    raw.insert(raw.end(), frame.begin(), frame.end());
+  }
+  const auto complete_size = raw.size();
+  // An incomplete frame stops the batch
+  const auto incomplete = make_frame(http2::frame_type::DATA, 0, 1, std::vector<uint8_t>(10));
+  raw.insert(raw.end(), incomplete.begin(), incomplete.end() - 1);
+
+  http2::frame_batch batch;
+  BOOST_CHECK(!batch.split(raw, 16384));
+  BOOST_REQUIRE_EQUAL(batch.size(), 3);
+  std::vector<std::string> names;
+  std::size_t batch_bytes = 0;
+  for (const auto &frame : batch) {
+    names.push_back(frame.visit(type_name{}));
+    batch_bytes += frame.size();
+  }
+  BOOST_CHECK((names == std::vector<std::string>{"ping", "headers", "window_update"}));
+  BOOST_CHECK_EQUAL(batch_bytes, complete_size);
+
+  // Frames before an invalid one are kept
+  const auto invalid = make_frame(http2::frame_type::DATA, 0, 0);
+  raw.resize(complete_size);
+  raw.insert(raw.end(), invalid.begin(), invalid.end());
+  BOOST_CHECK(batch.split(raw, 16384) == make_error_code(error_code::PROTOCOL_ERROR));
+  BOOST_CHECK_EQUAL(batch.size(), 3);
+
+  // A batch is limited
+  raw.clear();
+  const auto ping = make_frame(http2::frame_type::PING, 0, 0, std::vector<uint8_t>(8));
+  for (std::size_t i = 0; i < http2::frame_batch::MaxFrames + 1; ++i) {
+    raw.insert(raw.end(), ping.begin(), ping.end());
+  }
+  BOOST_CHECK(!batch.split(raw, 16384));
+  BOOST_CHECK_EQUAL(batch.size(), http2::frame_batch::MaxFrames);
+  BOOST_CHECK(!batch.split(std::span<const uint8_t>(raw).subspan(http2::frame_batch::MaxFrames * ping.size()), 16384));
+  BOOST_CHECK_EQUAL(batch.size(), 1);
+  BOOST_CHECK(!batch.split({}, 16384));
+  BOOST_CHECK(batch.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Read_buffers)
+
+BOOST_AUTO_TEST_CASE(Read_buffer_size_adaptation) {
+  using http2::read_buffer_pool;
+  auto pool = std::make_shared<read_buffer_pool>();
+  BOOST_CHECK_EQUAL(pool->buffer_size(), read_buffer_pool::MinSize);
+
+  // Full reads grow a buffer up to the limit
+  for (int i = 0; i < 10; ++i) {
+    pool->on_read(pool->buffer_size(), pool->buffer_size());
+  }
+  BOOST_CHECK_EQUAL(pool->buffer_size(), read_buffer_pool::MaxSize);
+
+  // A read into a partially used buffer doesn't mean that a socket has more data
+  pool = std::make_shared<read_buffer_pool>();
+  pool->on_read(100, 100);
+  BOOST_CHECK_EQUAL(pool->buffer_size(), read_buffer_pool::MinSize);
+
+  pool->on_frame_size(read_buffer_pool::MinSize + 9);
+  BOOST_CHECK_EQUAL(pool->buffer_size(), read_buffer_pool::MinSize * 2);
+  BOOST_CHECK_EQUAL(pool->acquire(100000).max_size(), 100000);
+
+  // Series of small reads
+  for (std::size_t i = 0; i < read_buffer_pool::SmallReadsToShrink - 1; ++i) {
+    pool->on_read(10, pool->buffer_size());
+  }
+  BOOST_CHECK_EQUAL(pool->buffer_size(), read_buffer_pool::MinSize * 2);
+  pool->on_read(10, pool->buffer_size());
+  BOOST_CHECK_EQUAL(pool->buffer_size(), read_buffer_pool::MinSize);
+}
+
+BOOST_AUTO_TEST_CASE(Read_buffer_recycling) {
+  auto pool = std::make_shared<http2::read_buffer_pool>();
+  auto buff = pool->acquire();
+  buff.commit(10);
+  const auto *memory = buff.prepare().data() - 10;
+
+  pool->release(std::move(buff));
+  auto recycled = pool->acquire();
+  BOOST_CHECK_EQUAL(recycled.prepare().data(), memory);
+  BOOST_CHECK(recycled.data_view().empty());
+
+  // A slab comes back with the last reference
+  recycled.commit(20);
+  auto slab = pool->make_slab(std::move(recycled));
+  auto slice = utils::buffer_slice(slab, slab->data_view().subspan(5));
+  slab.reset();
+  BOOST_CHECK(pool->acquire().prepare().data() != memory);
+  slice = utils::buffer_slice();
+  BOOST_CHECK_EQUAL(pool->acquire().prepare().data(), memory);
+
+  // Buffers of an old size are not recycled
+  auto old = pool->acquire();
+  pool->on_frame_size(http2::read_buffer_pool::MaxSize);
+  memory = old.prepare().data();
+  pool->release(std::move(old));
+  BOOST_CHECK(pool->acquire().prepare().data() != memory);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Stream)
+
+BOOST_AUTO_TEST_CASE(Send_request_body) {
+  auto tmpl = std::make_shared<rfc7541::header_template>(
+      std::initializer_list<rfc7541::header_field>{{":scheme", "https"}, {":authority", "localhost"}});
+  http2::request rq(tmpl, "/upload", http2::method::POST);
+  rq.body(std::string(30000, 'a')).body(std::vector<uint8_t>(10000, 'b'));
+
+  boost::asio::io_context io;
+  http2::stream stream(io, 1, 1 << 20, 65535, std::move(rq), [](boost::system::error_code, http2::response &&) {});
+  rfc7541::encoder encoder;
+
+  // A new stream is scheduled. It is scheduled again while it has data
+  std::deque<utils::buffer> out;
+  do {
+    BOOST_REQUIRE_NE(stream.get_tx_data(out, encoder, 16384), 0);
+  } while (stream.check_tx_data());
+
+  std::vector<uint8_t> body;
+  std::vector<uint8_t> frame_flags;
+  for (const auto &buff : out) {
+    auto frame = http2::frame_analyzer::parse(buff.data_view(), 16384);
+    BOOST_REQUIRE(frame.has_value() && frame->is_complete());
+    frame_flags.push_back(frame->frame_header().flags);
+    if (frame->frame_header().type == http2::frame_type::DATA) {
+      auto payload = buff.data_view().subspan(sizeof(http2::header));
+      body.insert(body.end(), payload.begin(), payload.end());
+    }
+  }
+
+  // HEADERS without END_STREAM and 3 DATA frames. The last one ends the stream
+  BOOST_REQUIRE_EQUAL(out.size(), 4);
+  BOOST_CHECK_EQUAL(frame_flags.front(), http2::flags::END_HEADERS);
+  BOOST_CHECK_EQUAL(frame_flags[1], 0);
+  BOOST_CHECK_EQUAL(frame_flags.back(), http2::flags::END_STREAM);
+  BOOST_REQUIRE_EQUAL(body.size(), 40000);
+  BOOST_CHECK(std::all_of(body.begin(), body.begin() + 30000, [](uint8_t c) { return c == 'a'; }));
+  BOOST_CHECK(std::all_of(body.begin() + 30000, body.end(), [](uint8_t c) { return c == 'b'; }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Receive)
+
+BOOST_AUTO_TEST_CASE(Data_of_unknown_stream_with_partial_header) {
+  boost::asio::io_context io;
+  test_client client(io);
+
+  // DATA for a stream that doesn't exist and the first bytes of the next frame header in one read
+  const auto data = make_frame(http2::frame_type::DATA, 0, 1, std::vector<uint8_t>(4096, 'a'));
+  const auto ping = make_frame(http2::frame_type::PING, 0, 0, std::vector<uint8_t>(8, 'p'));
+  auto buff = client.acquire_read_buffer();
+  const auto *memory = buff.prepare().data();
+  buff.commit(data);
+  buff.commit(std::span(ping).first(5));
+
+  // The rest is copied while the slab is alive, so it is not copied into the slab memory itself
+  auto rest = client.on_read(std::move(buff), data.size() + 5);
+  BOOST_CHECK(rest.data_view().data() != memory);
+  BOOST_REQUIRE_EQUAL(rest.data_view().size(), 5);
+  BOOST_CHECK(std::equal(rest.data_view().begin(), rest.data_view().end(), ping.begin()));
+
+  rest.commit(std::span(ping).subspan(5));
+  rest = client.on_read(std::move(rest), ping.size() - 5);
+  BOOST_CHECK(rest.data_view().empty());
+}
+
+BOOST_AUTO_TEST_CASE(Small_data_is_copied) {
+  boost::asio::io_context io;
+  test_client client(io);
+
+  // A small DATA frame doesn't turn the read buffer into a slab. The buffer is reused for the next read
+  const auto data = make_frame(http2::frame_type::DATA, 0, 1, std::vector<uint8_t>(100, 'a'));
+  auto buff = client.acquire_read_buffer();
+  const auto *memory = buff.prepare().data();
+  buff.commit(data);
+  buff.commit(std::span(data).first(5));
+
+  auto rest = client.on_read(std::move(buff), data.size() + 5);
+  BOOST_CHECK_EQUAL(rest.data_view().data(), memory + data.size());
+  BOOST_CHECK_EQUAL(rest.data_view().size(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(Full_size_data_is_sliced_from_max_buffer) {
+  boost::asio::io_context io;
+  test_client client(io);
+
+  // Reads those fill whole buffers grow the buffer size up to the max one
+  const auto filler = make_frame(http2::frame_type::DATA, 0, 1, std::vector<uint8_t>(16384 - 9, 'f'));
+  auto buff = client.acquire_read_buffer();
+  while (buff.max_size() < http2::read_buffer_pool::MaxSize) {
+    const auto size = buff.max_size();
+    for (std::size_t i = 0; i < size / filler.size(); ++i) {
+      buff.commit(filler);
+    }
+    buff = client.on_read(std::move(buff), size);
+  }
+
+  // A DATA frame of the default max frame size turns the buffer into a slab. The rest isn't left in it
+  const auto data = make_frame(http2::frame_type::DATA, 0, 1, std::vector<uint8_t>(16384, 'a'));
+  const auto *memory = buff.prepare().data();
+  buff.commit(data);
+  buff.commit(std::span(data).first(5));
+  auto rest = client.on_read(std::move(buff), data.size() + 5);
+  BOOST_CHECK(rest.data_view().data() != memory + data.size());
+  BOOST_CHECK_EQUAL(rest.data_view().size(), 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
@@ -3,10 +3,16 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <numeric>
+#include <thread>
+#include <vector>
 
 #include <utils/buffer.h>
+#include <utils/buffer_slice.h>
+#include <utils/coalesce.h>
 #include <utils/endianess.h>
+#include <utils/memory_resource.h>
 #include <utils/streambuf.h>
 #include <utils/utils.h>
 
@@ -270,14 +276,110 @@ BOOST_AUTO_TEST_CASE(Buffer_Consume) {
   BOOST_CHECK_EQUAL(buf.data_view().size(), 0);
   BOOST_CHECK_EQUAL_COLLECTIONS(buf.prepare().begin(), buf.prepare().end(), data.begin(), data.end());
 
+  // Consuming moves the read cursor only
   buf.commit(64);
   buf.consume(32);
-  BOOST_CHECK_EQUAL(buf.prepare().size(), 32);
+  BOOST_CHECK_EQUAL(buf.prepare().size(), 0);
   BOOST_CHECK_EQUAL(buf.data_view().size(), 32);
-  BOOST_CHECK_EQUAL_COLLECTIONS(buf.prepare().begin(), buf.prepare().end(), data.begin() + 32, data.end());
+  BOOST_CHECK_EQUAL(buf.data_view().data(), initial_data.data() + 32);
   BOOST_CHECK_EQUAL_COLLECTIONS(buf.data_view().begin(), buf.data_view().end(), data.begin() + 32, data.end());
 }
 
+BOOST_AUTO_TEST_CASE(Buffer_Compact) {
+  buffer buf(64);
+  auto initial_data = buf.prepare();
+  std::iota(initial_data.begin(), initial_data.end(), 0);
+  std::vector<uint8_t> data(64);
+  std::iota(data.begin(), data.end(), 0);
+
+  buf.compact();
+  BOOST_CHECK_EQUAL(buf.prepare().size(), 64);
+
+  buf.commit(48);
+  buf.consume(40);
+  buf.compact();
+  BOOST_CHECK_EQUAL(buf.prepare().size(), 56);
+  BOOST_CHECK_EQUAL(buf.data_view().data(), initial_data.data());
+  BOOST_CHECK_EQUAL_COLLECTIONS(buf.data_view().begin(), buf.data_view().end(), data.begin() + 40,
+                                data.begin() + 48);
+
+  // Written data follows the compacted one
+  buf.commit(std::span<const uint8_t>(data).subspan(48));
+  BOOST_CHECK_EQUAL(buf.data_view().size(), 24);
+  BOOST_CHECK_EQUAL_COLLECTIONS(buf.data_view().begin(), buf.data_view().end(), data.begin() + 40, data.end());
+
+  // A moved buffer keeps cursors
+  buf.consume(8);
+  auto moved = std::move(buf);
+  BOOST_CHECK_EQUAL(moved.data_view().size(), 16);
+  BOOST_CHECK_EQUAL_COLLECTIONS(moved.data_view().begin(), moved.data_view().end(), data.begin() + 48, data.end());
+}
+
+BOOST_AUTO_TEST_CASE(Buffer_Slice) {
+  buffer buf(64);
+  std::iota(buf.prepare().begin(), buf.prepare().end(), 0);
+  buf.commit(48);
+  const auto *memory = buf.data_view().data();
+
+  std::weak_ptr<const buffer> weak;
+  buffer_slice second;
+  {
+    auto slab = std::make_shared<const buffer>(std::move(buf));
+    weak = slab;
+    // Memory of a moved buffer is shared without copying
+    buffer_slice first(slab, slab->data_view().subspan(0, 16));
+    second = buffer_slice(slab, slab->data_view().subspan(16));
+    BOOST_CHECK_EQUAL(first.data_view().data(), memory);
+    BOOST_CHECK_EQUAL(first.data_view().size(), 16);
+  }
+  // The last slice keeps the slab
+  BOOST_REQUIRE(!weak.expired());
+  BOOST_CHECK_EQUAL(second.data_view().data(), memory + 16);
+  BOOST_CHECK_EQUAL(second.data_view().size(), 32);
+  BOOST_CHECK_EQUAL(second.data_view()[0], 16);
+
+  second = buffer_slice();
+  BOOST_CHECK(weak.expired());
+  BOOST_CHECK(second.data_view().empty());
+
+  buffer whole(8);
+  whole.commit(4);
+  buffer_slice slice(std::move(whole));
+  BOOST_CHECK_EQUAL(slice.data_view().size(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(Buffer_Coalesce) {
+  std::vector<uint8_t> data(1000);
+  std::iota(data.begin(), data.end(), 0);
+  std::size_t offset = 0;
+  auto make = [&](std::size_t size) {
+    buffer b(size);
+    b.commit(std::span<const uint8_t>(data).subspan(offset, size));
+    offset += size;
+    return b;
+  };
+
+  std::deque<buffer> buffers;
+  // Small buffers are joined into chunks up to 100 bytes
+  for (auto size : {9, 20, 30, 40, 9, 8, 500, 9, 300, 10, 10, 5}) {
+    buffers.emplace_back(make(size));
+  }
+  const auto *big = buffers[6].data_view().data();
+
+  auto result = coalesce(std::move(buffers), 100, 200);
+  std::vector<std::size_t> sizes;
+  std::vector<uint8_t> joined;
+  for (const auto &b : result) {
+    sizes.push_back(b.data_view().size());
+    joined.insert(joined.end(), b.data_view().begin(), b.data_view().end());
+  }
+  BOOST_CHECK((sizes == std::vector<std::size_t>{99, 17, 500, 9, 300, 25}));
+  BOOST_CHECK_EQUAL(result[2].data_view().data(), big);
+  BOOST_CHECK_EQUAL_COLLECTIONS(joined.begin(), joined.end(), data.begin(), data.begin() + offset);
+
+  BOOST_CHECK(coalesce({}, 100, 200).empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(Streambuf)
@@ -339,3 +441,78 @@ BOOST_AUTO_TEST_CASE(Streambuf_Push_back) {
   BOOST_CHECK_EQUAL(buffs.back().data_view().size(), 1);
 }
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(Memory_resource)
+
+BOOST_AUTO_TEST_CASE(Pooled_resource_reuse) {
+  pooled_resource resource;
+
+  auto *p = resource.allocate(100);
+  resource.deallocate(p, 100);
+  // The same size class
+  auto *q = resource.allocate(128);
+  BOOST_CHECK_EQUAL(p, q);
+  resource.deallocate(q, 128);
+
+  auto *big = resource.allocate(pooled_resource::MaxBlockSize + 1);
+  resource.deallocate(big, pooled_resource::MaxBlockSize + 1);
+
+  auto stats = resource.get_statistics();
+  BOOST_CHECK_EQUAL(stats.hits, 1);
+  BOOST_CHECK_EQUAL(stats.misses, 1);
+  BOOST_CHECK_EQUAL(stats.unpooled, 1);
+}
+
+BOOST_AUTO_TEST_CASE(Pooled_resource_threads) {
+  pooled_resource resource;
+  constexpr std::size_t Count = 100;
+
+  std::vector<void *> blocks;
+  for (std::size_t i = 0; i < Count; ++i) {
+    blocks.push_back(resource.allocate(1000));
+  }
+  // Blocks that are released by another thread go to shared lists when the thread exits
+  std::thread([&]() {
+    for (auto *p : blocks) {
+      resource.deallocate(p, 1000);
+    }
+  }).join();
+
+  for (auto &p : blocks) {
+    p = resource.allocate(1000);
+  }
+  auto stats = resource.get_statistics();
+  BOOST_CHECK_EQUAL(stats.hits + stats.misses, Count * 2);
+  BOOST_CHECK_GE(stats.hits, 32);
+  for (auto *p : blocks) {
+    resource.deallocate(p, 1000);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Buffer_with_resource) {
+  pooled_resource resource;
+  const uint8_t *memory = nullptr;
+  {
+    buffer buf(500, &resource);
+    memory = buf.prepare().data();
+    buffer moved(64, &resource);
+    moved = std::move(buf);
+    BOOST_CHECK_EQUAL(moved.max_size(), 500);
+  }
+  buffer reused(512, &resource);
+  BOOST_CHECK_EQUAL(reused.prepare().data(), memory);
+  BOOST_CHECK_EQUAL(resource.get_statistics().hits, 1);
+
+  // The default resource can be replaced
+  auto *prev = set_default_buffer_resource(&resource);
+  BOOST_CHECK_EQUAL(prev, &default_pooled_resource());
+  {
+    buffer buf(500);
+    auto stats = resource.get_statistics();
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, 4);
+  }
+  set_default_buffer_resource(nullptr);
+  BOOST_CHECK_EQUAL(default_buffer_resource(), &default_pooled_resource());
+}
+
+BOOST_AUTO_TEST_SUITE_END()